@@ -21,7 +21,22 @@ limitations under the License.
  *
  * Configures the ADC to sample on CH0 and store conversion
  * results into a circular buffer. Conversions are triggered
- * from the Timer0 CMPA signal.
+ * from the Timer0 CMPA signal. Samples are stored either as
+ * 8-bit unsigned PCM (top 8 bits of the conversion) or as
+ * 16-bit signed PCM (full 10-bit conversion).
+ *
+ * In oversampled mode conversions are triggered at 2x or 4x the
+ * output sample rate and decimated by a first order CIC (boxcar
+ * integrate and dump) filter: R conversions are summed and one
+ * sample of 10 + log2(R) bits is emitted per output period. The
+ * decimator uses 16-bit integer arithmetic only. Oversampling is
+ * limited to trigger rates the ADC converts at full accuracy (ADC
+ * clock 250 kHz or below, 18 kHz trigger), which leaves 2x at 8 kHz.
+ *
+ * ISR cycle budget (16 MHz): one trigger period is 512 cycles at
+ * 31.25 kHz, shared with the Timer0 CMPA ISR. Build
+ * with ADC_PROFILE defined to measure the ISR body with Timer1
+ * (adc_maxCycles); ~25 cycles of ISR entry/exit are not included.
  *
  * Requires:
  *   timer	- Configures Timer0 to trigger ADC conversions. 
@@ -40,6 +55,25 @@ limitations under the License.
 #include <avr/interrupt.h>
 
 #include "buffer.h"
+#include "adpcm.h"
+#include "g711.h"
+#include "adc.h"
+
+/************************************************************************/
+/* GLOBAL VARIABLES                                                     */
+/************************************************************************/
+uint8_t adcPrescaler = 0x06;	// ADC clock prescaler bits (ADPS2:0), default /64
+uint8_t adcFormat = ADC_FORMAT_PCM8;	// Stored sample format (ADC_FORMAT_xxx)
+
+uint8_t adcShift = 0;			// log2 of oversampling ratio (0: off, 1: 2x, 2: 4x)
+uint8_t adcRatio = 1;			// Oversampling ratio (conversions per output sample)
+uint8_t adcScale = 6;			// Left shift of the decimator sum to 16-bit full scale
+uint8_t adcDecimate = 1;		// Conversions remaining in the current output period
+uint16_t adcSum = 0;			// Decimator (boxcar integrator) accumulator
+
+#ifdef ADC_PROFILE
+volatile uint16_t adcMaxCycles = 0;	// Longest measured ISR body (CPU cycles)
+#endif
 
 /************************************************************************/
 /* PUBLIC/USER FUNCTIONS                                                */
@@ -47,16 +81,134 @@ limitations under the License.
 void adc_init() {
 	ADMUX = 0x60;	// Left adjust result, AREF = AVCC
 	ADCSRB = 0x03;	// Select Timer0 CMPA as trigger	
+	
+#ifdef ADC_PROFILE
+	TCCR1A = 0x00;	// Normal mode
+	TCCR1B = 0x01;	// Start Timer1, /1 prescaler (counts CPU cycles)
+#endif
+}
+
+/**
+ * Function: adc_setRate
+ * 
+ * Selects the slowest (most accurate) ADC clock that completes an
+ * auto-triggered conversion (13.5 ADC clocks) within one sample period.
+ * Takes effect on the next call to adc_start.
+ *
+ * Full 10-bit resolution needs an ADC clock of 50 - 200 kHz. The 
+ * 250 kHz clock (11.025 and 15.625 kHz) is slightly above this, and 
+ * the 500 kHz clock needed for 22.05 and 31.25 kHz reduces the 
+ * effective resolution to about 8 bits. The 8-bit result (ADCH) is 
+ * unaffected in practice; 10-bit capture gains little over it at 
+ * those two rates.
+ *
+ * Parameters:
+ *    hz - Sample rate (Timer0 CMPA trigger rate) in Hz
+ */
+void adc_setRate(uint16_t hz) {
+	if (hz <= 9000)
+		adcPrescaler = 0x07;	// /128 prescaler (125 kHz clock, 9.2 kHz max)
+	else if (hz <= 18000)
+		adcPrescaler = 0x06;	// /64 prescaler (250 kHz clock, 18.5 kHz max)
+	else
+		adcPrescaler = 0x05;	// /32 prescaler (500 kHz clock, 37 kHz max)
+}
+
+/**
+ * Function: adc_setOversample
+ * 
+ * Selects the oversampling ratio. Timer0 must be configured to trigger
+ * conversions at (sample rate << shift) and the ADC prescaler selected
+ * for that trigger rate. Must not be called while conversions are enabled.
+ *
+ * Parameters:
+ *    shift - log2 of oversampling ratio (0: off, 1: 2x, 2: 4x)
+ */
+void adc_setOversample(uint8_t shift) {
+	adcShift = shift;
+	adcRatio = 1 << shift;
+	adcScale = 6 - shift;
+}
+
+/**
+ * Function: adc_setFormat
+ * 
+ * Selects the sample format stored into the buffer. 8-bit samples are
+ * the left adjusted top 8 bits of the conversion (unsigned). All other
+ * formats start from the full right adjusted 10-bit conversion, 
+ * converted to signed 16-bit PCM; this is stored directly (16-bit), 
+ * encoded as IMA ADPCM blocks (see adpcm.c) or companded to 8-bit 
+ * mu-law/A-law (see g711.c). Must not be called while conversions 
+ * are enabled.
+ *
+ * Parameters:
+ *    format - Sample format (ADC_FORMAT_xxx)
+ */
+void adc_setFormat(uint8_t format) {
+	adcFormat = format;
 }
 
 void adc_start() {
-	ADCSRA = 0xAE;	// /64 prescaler (250 kHz clock), enable interrupts, ADC enable
+	// Full 10-bit result is needed for 16-bit/ADPCM samples and for decimation
+	ADMUX = ((adcFormat != ADC_FORMAT_PCM8) || adcShift) ? 0x40 : 0x60;	// Right/left adjust result, AREF = AVCC
+	
+	// Start a new output period
+	adcSum = 0;
+	adcDecimate = adcRatio;
+	
+	ADCSRA = 0xA8 | adcPrescaler;	// Selected prescaler, enable interrupts, ADC enable
 }
 
+#ifdef ADC_PROFILE
+/**
+ * Function: adc_maxCycles
+ * 
+ * Returns: The longest ADC ISR body measured since the last call (CPU cycles).
+ */
+uint16_t adc_maxCycles() {
+	uint16_t cycles = adcMaxCycles;
+	adcMaxCycles = 0;
+	return cycles;
+}
+#endif
+
 void adc_stop() {
 	ADCSRA = 0x00;
 }
 
+/************************************************************************/
+/* PRIVATE/UTILLITY FUNCTIONS                                           */
+/************************************************************************/
+
+/**
+ * Function: adc_store
+ * 
+ * Utility function. Stores a signed 16-bit sample into the buffer in
+ * the selected (wide) sample format.
+ *
+ * Parameters:
+ *    sample - Signed 16-bit sample.
+ */
+static void adc_store(uint16_t sample) {
+	switch (adcFormat) {
+		case ADC_FORMAT_PCM16:
+			buffer_queueWord(sample);
+			break;
+		case ADC_FORMAT_ADPCM:
+			adpcm_queue((int16_t)sample);
+			break;
+		case ADC_FORMAT_ULAW:
+			buffer_queue(g711_ulaw((int16_t)sample));
+			break;
+		case ADC_FORMAT_ALAW:
+			buffer_queue(g711_alaw((int16_t)sample));
+			break;
+		default:
+			buffer_queue((sample >> 8) ^ 0x80);	// Top 8 bits, unsigned
+			break;
+	}
+}
+
 /************************************************************************/
 /* INTERRUPT SERVICE ROUTINES                                           */
 /************************************************************************/
@@ -67,6 +219,33 @@ void adc_stop() {
  * Interrupt service routine which executes on completion of ADC conversion.
  */
 ISR(ADC_vect) {
-	uint8_t result = ADCH;	//Read result
-	buffer_queue(result);	//Store result into buffer
+#ifdef ADC_PROFILE
+	uint16_t start = TCNT1;
+#endif
+
+	if (adcShift) {
+		// Oversampled: integrate conversions, dump one sample per output period
+		adcSum += ADC;
+		if (!(--adcDecimate)) {
+			// Scale sum of R 10-bit conversions to 16-bit, offset binary to two's complement
+			uint16_t result = (adcSum << adcScale) ^ 0x8000;
+			adcSum = 0;
+			adcDecimate = adcRatio;
+			
+			adc_store(result);
+		}
+	} else if (adcFormat != ADC_FORMAT_PCM8) {
+		// Offset binary 10-bit to two's complement (invert MSB), scale to 16-bit
+		uint16_t result = (ADC ^ 0x0200) << 6;	//Read result
+		adc_store(result);						//Store result into buffer
+	} else {
+		uint8_t result = ADCH;	//Read result
+		buffer_queue(result);	//Store result into buffer
+	}
+
+#ifdef ADC_PROFILE
+	uint16_t cycles = TCNT1 - start;
+	if (cycles > adcMaxCycles)
+		adcMaxCycles = cycles;
+#endif
 }
\ No newline at end of file
@@ -28,8 +28,25 @@ limitations under the License.
 #ifndef ADC_H_
 #define ADC_H_
 
+// Sample formats stored into the buffer
+enum {
+	ADC_FORMAT_PCM8,	// 8-bit unsigned PCM
+	ADC_FORMAT_PCM16,	// 16-bit signed PCM
+	ADC_FORMAT_ADPCM,	// 4-bit IMA ADPCM blocks
+	ADC_FORMAT_ULAW,	// 8-bit G.711 mu-law
+	ADC_FORMAT_ALAW,	// 8-bit G.711 A-law
+	ADC_FORMAT_COUNT
+};
+
 void adc_init();	// Initialises ADC
+void adc_setRate(uint16_t hz);	// Selects the ADC clock prescaler for a sample rate
+void adc_setFormat(uint8_t format);	// Selects the sample format stored into the buffer (ADC_FORMAT_xxx)
+void adc_setOversample(uint8_t shift);	// Selects oversampling ratio (1 << shift) with CIC decimation
 void adc_start();	// Enables ADC to start conversions (triggered by Timer0 CMPA)
 void adc_stop();	// Disables ADC conversions
 
+#ifdef ADC_PROFILE
+uint16_t adc_maxCycles();	// Returns longest measured ADC ISR body (CPU cycles)
+#endif
+
 #endif /* ADC_H_ */
\ No newline at end of file
@@ -0,0 +1,281 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+/**
+ * adpcm.c - EGB240DVR Library, IMA ADPCM codec module
+ *
+ * Implements the IMA (DVI) ADPCM codec used by WAVE format 0x11. Each
+ * 16-bit sample is coded as a 4-bit step relative to a prediction,
+ * reducing the data rate (and SD card write bandwidth) by 4:1 against
+ * 16-bit PCM, or 2:1 against 8-bit PCM.
+ *
+ * Samples are encoded/decoded one at a time directly into/out of the
+ * circular buffer, so no block buffer is needed in RAM. Each block 
+ * holds a 4 byte header (first sample, step index, reserved byte) 
+ * followed by 4-bit codes, low nibble first. Blocks are exactly one
+ * buffer page, so blocks always start at the top of a page. If the
+ * buffer discards samples (overrun) the encoder restarts at a new
+ * block; if the buffer runs dry (underrun) the decoder holds its last
+ * sample until the next block is available.
+ *
+ * Requires:
+ *   buffer - Circular buffer (queue) used to store audio samples.
+ *            Page size must equal ADPCM_BLOCK_SIZE.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified by: Sid 
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+/************************************************************************/
+/* INCLUDED LIBRARIES/HEADER FILES                                      */
+/************************************************************************/
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "buffer.h"
+#include "adpcm.h"
+
+/************************************************************************/
+/* LOOKUP TABLES                                                        */
+/************************************************************************/
+
+// Step index adjustment for each code magnitude
+const int8_t adpcmIndexTable[8] PROGMEM = {
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// Quantiser step size for each step index
+const uint16_t adpcmStepTable[89] PROGMEM = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+	19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/************************************************************************/
+/* GLOBAL VARIABLES                                                     */
+/************************************************************************/
+ADPCM_STATE encoder;	// Encoder state (recording)
+uint16_t encRemain;		// Samples remaining in the current encoder block (0: start new block)
+uint8_t encNibble;		// Pending low nibble (first code of a byte)
+
+ADPCM_STATE decoder;	// Decoder state (playback)
+uint16_t decRemain;		// Samples remaining in the current decoder block (0: start new block)
+uint8_t decByte;		// Byte holding the pending high nibble
+
+/************************************************************************/
+/* PRIVATE/UTILLITY FUNCTIONS                                           */
+/************************************************************************/
+
+/**
+ * Function: adpcm_update
+ * 
+ * Utility function. Applies a code to the codec state: the predictor
+ * is moved by the quantised difference (clamped to 16-bit) and the 
+ * step index adapted (clamped to the step table).
+ *
+ * Parameters:
+ *    state - Codec state to update.
+ *    code - 4-bit code (bit 3 sign, bits 2-0 magnitude).
+ *    step - Step size for the current step index.
+ */
+static void adpcm_update(ADPCM_STATE* state, uint8_t code, uint16_t step) {
+	// Quantised difference = step * (magnitude + 0.5) / 4
+	uint16_t delta = step >> 3;
+	if (code & 4) delta += step;
+	if (code & 2) delta += step >> 1;
+	if (code & 1) delta += step >> 2;
+	
+	int32_t predictor = state->predictor;
+	if (code & 8)
+		predictor -= delta;
+	else
+		predictor += delta;
+	
+	if (predictor > 32767) predictor = 32767;
+	else if (predictor < -32768) predictor = -32768;
+	state->predictor = (int16_t)predictor;
+	
+	int8_t index = (int8_t)state->index + (int8_t)pgm_read_byte(&adpcmIndexTable[code & 7]);
+	if (index < 0) index = 0;
+	else if (index > 88) index = 88;
+	state->index = (uint8_t)index;
+}
+
+/************************************************************************/
+/* PUBLIC/USER FUNCTIONS                                                */
+/************************************************************************/
+
+/**
+ * Function: adpcm_reset
+ * 
+ * Resets the encoder and decoder so the next sample queued/dequeued
+ * starts a new block. Must be called at the start of every record or
+ * playback session (after buffer_reset).
+ */
+void adpcm_reset() {
+	encoder.predictor = 0;
+	encoder.index = 0;
+	encRemain = 0;
+	
+	decoder.predictor = 0;
+	decoder.index = 0;
+	decRemain = 0;
+}
+
+/**
+ * Function: adpcm_encode
+ * 
+ * Encodes a sample as a 4-bit code relative to the current prediction
+ * and updates the encoder state.
+ *
+ * Parameters:
+ *    state - Encoder state.
+ *    sample - Signed 16-bit sample to encode.
+ *
+ * Returns: 4-bit code (bit 3 sign, bits 2-0 magnitude)
+ */
+uint8_t adpcm_encode(ADPCM_STATE* state, int16_t sample) {
+	uint16_t step = pgm_read_word(&adpcmStepTable[state->index]);
+	uint16_t diff;
+	uint8_t code;
+	
+	// Magnitude of difference from prediction (fits 16 bits unsigned)
+	if (sample < state->predictor) {
+		code = 8;
+		diff = (uint16_t)state->predictor - (uint16_t)sample;
+	} else {
+		code = 0;
+		diff = (uint16_t)sample - (uint16_t)state->predictor;
+	}
+	
+	// Quantise magnitude in units of step / 4 (successive approximation)
+	uint16_t s = step;
+	if (diff >= s) { code |= 4; diff -= s; }
+	s >>= 1;
+	if (diff >= s) { code |= 2; diff -= s; }
+	s >>= 1;
+	if (diff >= s) { code |= 1; }
+	
+	// Track the decoder's reconstruction
+	adpcm_update(state, code, step);
+	
+	return code;
+}
+
+/**
+ * Function: adpcm_decode
+ * 
+ * Decodes a 4-bit code and updates the decoder state.
+ *
+ * Parameters:
+ *    state - Decoder state.
+ *    code - 4-bit code (bit 3 sign, bits 2-0 magnitude).
+ *
+ * Returns: Decoded signed 16-bit sample
+ */
+int16_t adpcm_decode(ADPCM_STATE* state, uint8_t code) {
+	adpcm_update(state, code, pgm_read_word(&adpcmStepTable[state->index]));
+	return state->predictor;
+}
+
+/**
+ * Function: adpcm_queue
+ * 
+ * Encodes a sample into the buffer. The first sample of each block is
+ * stored uncompressed in the block header; the remaining samples are
+ * stored as 4-bit codes, two per byte. If the buffer discards the 
+ * first byte of a block (overrun), the block is restarted with the 
+ * next sample, so blocks stay aligned with buffer pages.
+ *
+ * Parameters:
+ *    sample - Signed 16-bit sample to add to queue (buffer)
+ */
+void adpcm_queue(int16_t sample) {
+	if (!encRemain) {
+		// Block header: first sample, step index, reserved
+		if (!buffer_queue((uint8_t)sample))
+			return;		// Buffer full, retry header with next sample
+		buffer_queue((uint8_t)((uint16_t)sample >> 8));
+		buffer_queue(encoder.index);
+		buffer_queue(0);
+		
+		encoder.predictor = sample;
+		encRemain = ADPCM_BLOCK_SAMPLES - 1;
+		return;
+	}
+	
+	uint8_t code = adpcm_encode(&encoder, sample);
+	
+	// Pack codes low nibble first
+	if (encRemain & 1)
+		buffer_queue(encNibble | (code << 4));
+	else
+		encNibble = code;
+	
+	encRemain--;
+}
+
+/**
+ * Function: adpcm_dequeue
+ * 
+ * Decodes a sample from the buffer. A new block is only started when
+ * the buffer holds a full page; otherwise the last decoded sample is 
+ * held (and the buffer logs an underrun).
+ *
+ * Returns: Decoded signed 16-bit sample
+ */
+int16_t adpcm_dequeue() {
+	if (!decRemain) {
+		if (!buffer_pagesFull()) {
+			buffer_dequeue();	// Log underrun, buffer does not advance
+			return decoder.predictor;
+		}
+		
+		// Block header: first sample, step index, reserved
+		uint16_t sample = buffer_dequeue();
+		sample |= (uint16_t)buffer_dequeue() << 8;
+		decoder.index = buffer_dequeue();
+		buffer_dequeue();
+		
+		if (decoder.index > 88)
+			decoder.index = 88;
+		decoder.predictor = (int16_t)sample;
+		decRemain = ADPCM_BLOCK_SAMPLES - 1;
+		return decoder.predictor;
+	}
+	
+	// Unpack codes low nibble first
+	uint8_t code;
+	if (decRemain & 1) {
+		code = decByte >> 4;
+	} else {
+		decByte = buffer_dequeue();
+		code = decByte & 0x0F;
+	}
+	
+	decRemain--;
+	return adpcm_decode(&decoder, code);
+}
\ No newline at end of file
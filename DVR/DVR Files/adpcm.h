@@ -0,0 +1,50 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+/**
+ * adpcm.h - EGB240DVR Library, IMA ADPCM codec module header
+ *
+ * Encodes/decodes 16-bit samples to/from 4-bit IMA ADPCM blocks
+ * (WAVE format 0x11) queued in the circular buffer.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified By: Sid
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+#ifndef ADPCM_H_
+#define ADPCM_H_
+
+// One ADPCM block per buffer page (and per SD card sector)
+#define ADPCM_BLOCK_SIZE		512									// Block size (bytes), WAVE BlockAlign
+#define ADPCM_BLOCK_SAMPLES		(((ADPCM_BLOCK_SIZE - 4) * 2) + 1)	// Samples per block (mono)
+
+// IMA ADPCM codec state
+typedef struct {
+	int16_t predictor;	// Predicted (last decoded) sample
+	uint8_t index;		// Index into step size table (0 - 88)
+} ADPCM_STATE;
+
+void adpcm_reset();						// Resets encoder/decoder for a new record/playback session
+uint8_t adpcm_encode(ADPCM_STATE* state, int16_t sample);	// Encodes a sample to a 4-bit code
+int16_t adpcm_decode(ADPCM_STATE* state, uint8_t code);		// Decodes a 4-bit code to a sample
+void adpcm_queue(int16_t sample);		// Encodes a sample into ADPCM blocks in the buffer
+int16_t adpcm_dequeue();				// Decodes a sample from ADPCM blocks in the buffer
+
+#endif /* ADPCM_H_ */
\ No newline at end of file
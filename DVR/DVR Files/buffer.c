@@ -22,14 +22,34 @@ limitations under the License.
  * Implements a circular buffer in RAM to temporarily store audio samples
  * when reading/writing to flash memory (SD card).
  *
- * The buffer is implemented as two 512 byte pages (contiguous 1024 byte
- * block of memory). Samples can be queued/dequeued a byte or a page at
- * a time. The buffer module provides callback functionality to signal
- * application code when a page is full (when writing samples bytewise) 
- * or empty (when reading samples bytewise). No overflow or underflow
- * protection is implemented.
- *
- * Version: v1.0
+ * The buffer is implemented as N pages carved from a contiguous block of
+ * memory supplied by the application (the arena). Samples can be 
+ * queued/dequeued a byte, a 16-bit word (two bytes, little endian), a
+ * page or a run of contiguous pages at a time. The page size must be a
+ * power of two so that page boundaries are found with a single mask
+ * test of the 16-bit head/tail index on every sample; all other work
+ * (wraparound, page accounting) happens once per page.
+ *
+ * The buffer is a single-producer/single-consumer queue. Exactly one
+ * side (the ADC ISR when recording, the main loop when playing) writes
+ * and the other side reads. The head index and head page counter are 
+ * only modified by the writer, the tail index and tail page counter are
+ * only modified by the reader. The page counters are single bytes, so 
+ * loads/stores are atomic on the AVR and no interrupt masking (cli) is 
+ * required. A compiler barrier ensures page contents are stored before
+ * the page counter publishing them. The number of full pages is the 
+ * difference of the two counters; the main loop polls this (through
+ * buffer_readPage/buffer_writePage/buffer_pagesFull) in place of 
+ * page full/empty callbacks.
+ *
+ * Overrun (the writer fills its page while every other page is still
+ * waiting to be read) and underrun (the reader empties its page before
+ * the next page is written) are detected at page boundaries. Overrun
+ * discards incoming samples until a page is released; underrun repeats
+ * the last sample until a page is committed. Each event is counted and
+ * its byte offset logged in the session statistics.
+ *
+ * Version: v1.2
  *    Date: 05/29/2017
  *  Modified by: Sid 
  *  E-mail: robo_sid@yahoo.co.uk
@@ -40,23 +60,160 @@ limitations under the License.
 /************************************************************************/
 #include <avr/io.h>
 
+#include "buffer.h"
+
+/************************************************************************/
+/* MACROS                                                               */
+/************************************************************************/
+
+// Compiler memory barrier: stores to page memory complete before page counters are published
+#define BUFFER_BARRIER()	__asm__ __volatile__ ("" ::: "memory")
+
 /************************************************************************/
 /* GLOBAL VARIABLES                                                     */
 /************************************************************************/
-uint8_t samples[1024];	// Buffer: 2 x 512 byte pages (1024 bytes total)
+uint8_t* pTop;			// Pointer to top of buffer (top of Page 0)
+uint16_t sizeArena;		// Size of the buffer (bytes)
+uint16_t sizePage;		// Size of a single page (bytes, power of two)
+uint16_t pageMask;		// Mask of index bits within a page (sizePage - 1)
+uint8_t numPages;		// Number of pages in the buffer
+
+uint16_t headIndex;		// Index of head of queue (write position, owned by writer)
+uint16_t tailIndex;		// Index of tail of queue (read position, owned by reader)
+
+volatile uint8_t headCount;	// Number of pages committed by the writer (free running)
+volatile uint8_t tailCount;	// Number of pages released by the reader (free running)
 
-uint8_t* pPage0	= samples;			// Pointer to top of Page 0
-uint8_t* pPage1	= samples + 512;	// Pointer to top of Page 1
-uint8_t* pEnd	= samples + 1024;	// Pointer to bottom of buffer
+volatile uint8_t endOfStream;	// Flag that indicates the writer will commit no more pages
 
-volatile uint8_t* pHead;	// Pointer to head of queue (write pointer)
-volatile uint8_t* pTail;	// Pointer to tail of queue (read pointer)	
+uint8_t overrun;		// Writer overrun state (0: none, 1: next page held, 2: discarding samples)
+uint8_t underrun;		// Reader underrun state (0: none, 1: next page empty, 2: repeating samples)
+uint8_t lastWord;		// Last sample returned by buffer_dequeue
+uint16_t lastPair;		// Last sample returned by buffer_dequeueWord
+uint16_t sessionPages;	// Number of pages passed by the bytewise writer/reader this session
+
+BUFFER_STATS stats;		// Overrun/underrun statistics for the current session
 
 /************************************************************************/
-/* FUNCTION POINTERS                                                    */
+/* PRIVATE/UTILLITY FUNCTIONS                                           */
 /************************************************************************/
-void (*callbackPageFull)(void);		// Pointer to "page full" function
-void (*callbackPageEmpty)(void);	// Pointer to "page empty" function
+
+/**
+ * Function: next_page
+ * 
+ * Utility function. Returns the index of the top of the page following
+ * a page boundary, wrapping around to Page 0 at the bottom of the buffer.
+ *
+ * Parameters:
+ *    index - Index of a page boundary (top of the following page).
+ */
+static uint16_t next_page(uint16_t index) {
+	return (index == sizeArena) ? 0 : index;
+}
+
+/**
+ * Function: log_event
+ * 
+ * Utility function. Records the byte offset of an overrun/underrun
+ * event if there is space remaining in the session log.
+ *
+ * Parameters:
+ *    log - Array of BUFFER_LOG_SIZE byte offsets.
+ *    count - Number of events of this type, including this event.
+ *    offset - Byte offset (from start of session) of this event.
+ */
+static void log_event(uint32_t* log, uint16_t count, uint32_t offset) {
+	if (count <= BUFFER_LOG_SIZE)
+		log[count - 1] = offset;
+}
+
+/**
+ * Function: queue_page
+ * 
+ * Called from buffer_queue/buffer_queueWord when the head index reaches
+ * a page boundary.
+ * Commits the page as full and checks whether the next page is free.
+ */
+static void queue_page() {
+	headIndex = next_page(headIndex);
+	sessionPages++;
+	
+	BUFFER_BARRIER();
+	headCount++;	// Publish page to reader
+	
+	// Next page not yet released by reader
+	if ((uint8_t)(headCount - tailCount) >= numPages)
+		overrun = 1;
+}
+
+/**
+ * Function: dequeue_page
+ * 
+ * Called from buffer_dequeue/buffer_dequeueWord when the tail index
+ * reaches a page boundary.
+ * Releases the page and checks whether the next page has been written.
+ */
+static void dequeue_page() {
+	tailIndex = next_page(tailIndex);
+	sessionPages++;
+	
+	BUFFER_BARRIER();
+	tailCount++;	// Return page to writer
+	
+	// Next page not yet committed by writer
+	if (headCount == tailCount)
+		underrun = 1;
+}
+
+/**
+ * Function: queue_blocked
+ * 
+ * Called from buffer_queue/buffer_queueWord while overrun. Discards the
+ * sample if the reader still holds the next page (logging the event on
+ * the first discarded sample), otherwise clears the overrun.
+ *
+ * Returns: True if the sample must be discarded.
+ */
+static uint8_t queue_blocked() {
+	if ((uint8_t)(headCount - tailCount) >= numPages) {
+		if (overrun == 1) {
+			overrun = 2;
+			stats.overruns++;
+			log_event(stats.overrunOffset, stats.overruns, (uint32_t)sessionPages * sizePage);
+		}
+		stats.samplesDropped++;
+		return 1;
+	}
+	
+	overrun = 0;	// Page released, resume at top of head page
+	return 0;
+}
+
+/**
+ * Function: dequeue_starved
+ * 
+ * Called from buffer_dequeue/buffer_dequeueWord while underrun. Holds
+ * the last sample if the writer has not committed the next page 
+ * (logging the event on the first held sample unless the stream has
+ * finished), otherwise clears the underrun.
+ *
+ * Returns: True if the last sample must be repeated.
+ */
+static uint8_t dequeue_starved() {
+	if (headCount == tailCount) {
+		if ((underrun == 1) && !endOfStream) {
+			underrun = 2;
+			stats.underruns++;
+			log_event(stats.underrunOffset, stats.underruns, (uint32_t)sessionPages * sizePage);
+		}
+		if (underrun == 2)
+			stats.samplesHeld++;
+		return 1;
+	}
+	
+	underrun = 0;	// Page committed, resume at top of tail page
+	return 0;
+}
 
 /************************************************************************/
 /* PUBLIC/USER FUNCTIONS                                                */
@@ -65,78 +222,173 @@ void (*callbackPageEmpty)(void);	// Pointer to "page empty" function
 /**
  * Function: buffer_init
  * 
- * Initialises the circular buffer for first use. Read/write pointers are
- * reset to the top of Page 0 and the user supplied callback functions
- * are assigned.
+ * Initialises the circular buffer for first use. The supplied arena is
+ * divided into pages and read/write indices are reset to the top of
+ * Page 0.
  *
  * Parameters:
- *    pFuncPageFull - Pointer to function to execute on "page full"
- *    pFuncPageEmpty - Pointer to function to execute on "page empty"
+ *    pArena - Pointer to a block of at least (pages * pageSize) bytes
+ *    pages - Number of pages in the buffer (2 or more)
+ *    pageSize - Size of each page in bytes (must be a power of two)
  */
-void buffer_init(void (*pFuncPageFull)(void), void (*pFuncPageEmpty)(void)) {
-	// Reset read/write pointers
-	pHead = pPage0;
-	pTail = pPage0;
+void buffer_init(uint8_t* pArena, uint8_t pages, uint16_t pageSize) {
+	// Carve the arena into pages
+	pTop = pArena;
+	sizeArena = (uint16_t)pages * pageSize;
+	sizePage = pageSize;
+	pageMask = pageSize - 1;
+	numPages = pages;
 	
-	// Assign user supplier callback functions
-	callbackPageFull = pFuncPageFull;
-	callbackPageEmpty = pFuncPageEmpty;
+	// Reset read/write indices
+	buffer_reset();
 }
 
 /**
  * Function: buffer_reset
  * 
- * Resets the read/write pointers of the buffer to the top of Page 0.
+ * Resets the read/write indices of the buffer to the top of Page 0
+ * and marks every page as empty. Session statistics are cleared.
+ * Must not be called while an ISR is reading or writing the buffer.
  */
 void buffer_reset() {
-	// Reset pointers to top of buffer
-	pHead = pPage0;
-	pTail = pPage0;
+	buffer_flush();
+	
+	// Start a new session
+	lastWord = 0x80;	// Mid-scale (silence)
+	lastPair = 0;		// Signed 16-bit silence
+	sessionPages = 0;
+	
+	uint8_t* p = (uint8_t*)&stats;
+	for (uint8_t i = 0; i < sizeof(stats); i++)
+		p[i] = 0;
+}
+
+/**
+ * Function: buffer_flush
+ * 
+ * Discards every queued page and resets the read/write indices to the
+ * top of Page 0 (e.g. to refill the buffer after a seek). Session 
+ * statistics are kept. Must not be called while an ISR is reading or
+ * writing the buffer.
+ */
+void buffer_flush() {
+	// Reset indices to top of buffer
+	headIndex = 0;
+	tailIndex = 0;
+	
+	// Buffer is empty
+	headCount = 0;
+	tailCount = 0;
+	endOfStream = 0;
+	
+	overrun = 0;
+	underrun = 0;
 }
 
 /**
  * Function: buffer_queue
  * 
  * Adds a sample to the head of the queue (buffer). The sample is 
- * placed at the memory location pointed to by pHead. The write 
- * pointer is automatically incremented (with wraparound where 
- * necessary). A "page full" callback is generated when the write
- * pointer overflows to a new page.
+ * placed at the head index, which is automatically incremented. 
+ * When the head index reaches a page boundary the page is committed
+ * as full (with wraparound where necessary).
+ *
+ * If the next page has not yet been released by the reader, an 
+ * overrun is logged and samples are discarded until it is released.
  *
  * Parameters:
  *    word - sample (unsigned 8-bit integer) to add to queue (buffer)
+ *
+ * Returns: True if the sample was stored, false if it was discarded
  */
-void buffer_queue(uint8_t word) {
-	*(pHead++) = word;
+uint8_t buffer_queue(uint8_t word) {
+	if (overrun && queue_blocked())
+		return 0;
 	
-	if (pHead == pPage1) {
-		callbackPageFull();
-	} else if (pHead == pEnd) {
-		pHead = pPage0;
-		callbackPageFull();
-	}	
+	uint16_t i = headIndex;
+	pTop[i++] = word;
+	headIndex = i;
+	
+	if (!(i & pageMask))
+		queue_page();
+	
+	return 1;
+}
+
+/**
+ * Function: buffer_queueWord
+ * 
+ * Adds a 16-bit sample to the head of the queue (buffer) as two bytes,
+ * least significant byte first (WAVE byte order). Pages hold a whole
+ * number of words, so a word never straddles a page boundary. Overrun
+ * is handled as for buffer_queue.
+ *
+ * Parameters:
+ *    word - sample (16-bit integer) to add to queue (buffer)
+ */
+void buffer_queueWord(uint16_t word) {
+	if (overrun && queue_blocked())
+		return;
+	
+	uint16_t i = headIndex;
+	pTop[i++] = (uint8_t)word;
+	pTop[i++] = (uint8_t)(word >> 8);
+	headIndex = i;
+	
+	if (!(i & pageMask))
+		queue_page();
 }
 
 /**
  * Function: buffer_dequeue
  * 
- * Removes and returns a sample from the head of the queue (buffer).  
- * The sample is loaded from the memory location pointed to by pTail. 
- * The read pointer is automatically incremented (with wraparound  
- * where necessary). A "page empty" callback is generated when the 
- * read pointer overflows to a new page.
+ * Removes and returns a sample from the tail of the queue (buffer).  
+ * The sample is loaded from the tail index, which is automatically
+ * incremented. When the tail index reaches a page boundary the page
+ * is released (with wraparound where necessary).
+ *
+ * If the next page has not yet been committed by the writer, an 
+ * underrun is logged and the last sample is repeated until it is.
+ * No underrun is logged once the writer has called buffer_finish.
  *
  * Returns: The sample read from the buffer (unsigned 8-bit integer)
  */
 uint8_t buffer_dequeue() {
-	uint8_t word = *(pTail++);
-		
-	if (pTail == pPage1) {
-		callbackPageEmpty();
-	} else if (pTail == pEnd) {
-		pTail = pPage0;
-		callbackPageEmpty();
-	}
+	if (underrun && dequeue_starved())
+		return lastWord;
+	
+	uint16_t i = tailIndex;
+	uint8_t word = pTop[i++];
+	tailIndex = i;
+	lastWord = word;
+	
+	if (!(i & pageMask))
+		dequeue_page();
+	
+	return word;
+}
+
+/**
+ * Function: buffer_dequeueWord
+ * 
+ * Removes and returns a 16-bit sample (two bytes, least significant 
+ * byte first) from the tail of the queue (buffer). Underrun is handled
+ * as for buffer_dequeue.
+ *
+ * Returns: The sample read from the buffer (16-bit integer)
+ */
+uint16_t buffer_dequeueWord() {
+	if (underrun && dequeue_starved())
+		return lastPair;
+	
+	uint16_t i = tailIndex;
+	uint16_t word = pTop[i++];
+	word |= (uint16_t)pTop[i++] << 8;
+	tailIndex = i;
+	lastPair = word;
+	
+	if (!(i & pageMask))
+		dequeue_page();
 	
 	return word;
 }
@@ -145,50 +397,162 @@ uint8_t buffer_dequeue() {
  * Function: buffer_readPage
  * 
  * Allows application code to read a full page from the buffer.
- * Returns a pointer to the top of the current page (assumes that
- * the read pointer is always page aligned). The read pointer is
- * advanced to the next page boundary immediately. Callbacks
- * are never generated from this function call.
+ * Returns a pointer to the top of the oldest full page (assumes 
+ * that the tail index is always page aligned). The page remains
+ * reserved for the application until buffer_releasePage is called.
  *
- * Returns: Pointer to the top of the current page (>= pTail)
+ * Returns: Pointer to the top of the oldest full page, or 0 if the
+ *          buffer holds no full pages
  */
 uint8_t* buffer_readPage() {
-	uint8_t* page;
-	
-	// Advance tail to next page boundary
-	if (pTail > pPage0) {
-		page = pPage1;
-		pTail = pPage0;
-	} else {
-		page = pPage0;
-		pTail = pPage1;
-	}
+	if (headCount == tailCount)
+		return 0;	// No full pages
 	
-	return page;
+	return pTop + tailIndex;
+}
+
+/**
+ * Function: buffer_releasePage
+ * 
+ * Releases the page returned by buffer_readPage, making it available
+ * to the writer. The tail index is advanced to the next page boundary.
+ */
+void buffer_releasePage() {
+	tailIndex = next_page(tailIndex + sizePage);
+	
+	BUFFER_BARRIER();
+	tailCount++;
 }
 
 /**
  * Function: buffer_writePage
  * 
  * Allows application code to write a full page to the buffer.
- * Returns a pointer to the top of the current page (assumes that
- * the write pointer is always page aligned). The write pointer is
- * advanced to the next page boundary immediately. Callbacks are
- * never generated from this function call.
+ * Returns a pointer to the top of the next empty page (assumes that
+ * the head index is always page aligned). The page is not queued
+ * for reading until buffer_commitPage is called.
  *
- * Returns: Pointer to the top of the current page (>= pHead)
+ * Returns: Pointer to the top of the next empty page, or 0 if every
+ *          page in the buffer is full
  */
 uint8_t* buffer_writePage() {
-	uint8_t* page;
-	
-	// Advance head to next page boundary
-	if (pHead > pPage0) {
-		page = pPage1;
-		pHead = pPage0;
-		} else {
-		page = pPage0;
-		pHead = pPage1;
-	}
+	if ((uint8_t)(headCount - tailCount) >= numPages)
+		return 0;	// No empty pages
+	
+	return pTop + headIndex;
+}
+
+/**
+ * Function: buffer_commitPage
+ * 
+ * Queues the page returned by buffer_writePage for reading. The head
+ * index is advanced to the next page boundary.
+ */
+void buffer_commitPage() {
+	headIndex = next_page(headIndex + sizePage);
+	
+	BUFFER_BARRIER();
+	headCount++;
+}
+
+/**
+ * Function: buffer_writePages
+ * 
+ * Allows application code to write several pages to the buffer in one
+ * transfer (e.g. a multi-sector read from the SD card). Returns a 
+ * pointer to the top of the next empty page and the number of empty
+ * pages following it that are contiguous in memory (the run stops at
+ * the bottom of the arena). The pages are not queued for reading 
+ * until buffer_commitPages is called.
+ *
+ * Parameters:
+ *    burst - Minimum number of pages to return. Fewer are returned only
+ *            where the bottom of the arena is reached first.
+ *    pCount - Receives the number of pages in the run.
+ *
+ * Returns: Pointer to the top of the next empty page, or 0 if fewer
+ *          than burst pages are empty
+ */
+uint8_t* buffer_writePages(uint8_t burst, uint8_t* pCount) {
+	uint8_t empty = numPages - (uint8_t)(headCount - tailCount);
+	uint8_t run = (sizeArena - headIndex) / sizePage;	// Pages to the bottom of the arena
+	
+	if (empty > run)
+		empty = run;
+	if (!empty || ((empty < burst) && (empty < run)))
+		return 0;	// Too few empty pages
 	
-	return page;
+	*pCount = empty;
+	return pTop + headIndex;
+}
+
+/**
+ * Function: buffer_commitPages
+ * 
+ * Queues pages returned by buffer_writePages for reading. The head
+ * index is advanced past the pages.
+ *
+ * Parameters:
+ *    count - Number of pages written (no more than returned in the run)
+ */
+void buffer_commitPages(uint8_t count) {
+	headIndex = next_page(headIndex + count * sizePage);
+	
+	BUFFER_BARRIER();
+	headCount += count;
+}
+
+/**
+ * Function: buffer_finish
+ * 
+ * Signals that the writer will commit no more pages this session.
+ * The reader stops reporting underrun once the remaining pages have
+ * been consumed.
+ */
+void buffer_finish() {
+	endOfStream = 1;
+}
+
+/**
+ * Function: buffer_pagesFull
+ * 
+ * Returns: The number of full pages currently held in the buffer.
+ */
+uint8_t buffer_pagesFull() {
+	return headCount - tailCount;
+}
+
+/**
+ * Function: buffer_pagesCommitted
+ * 
+ * Returns: The number of pages committed by the writer this session
+ *          (free running, modulo 256). The next page committed is
+ *          read once buffer_pagesReleased reaches this count.
+ */
+uint8_t buffer_pagesCommitted() {
+	return headCount;
+}
+
+/**
+ * Function: buffer_pagesReleased
+ * 
+ * Returns: The number of pages released by the reader this session
+ *          (free running, modulo 256). Changes as the last sample of
+ *          a page is read.
+ */
+uint8_t buffer_pagesReleased() {
+	return tailCount;
+}
+
+/**
+ * Function: buffer_stats
+ * 
+ * Returns the overrun/underrun statistics for the current session.
+ * Statistics are updated from interrupt context; they should be read
+ * once the session has stopped (or with interrupts disabled).
+ *
+ * Returns: Pointer to the session statistics structure
+ */
+const BUFFER_STATS* buffer_stats() {
+	return &stats;
 }
\ No newline at end of file
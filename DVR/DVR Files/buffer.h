@@ -31,14 +31,39 @@ limitations under the License.
 #ifndef BUFFER_H_
 #define BUFFER_H_
 
+#define BUFFER_LOG_SIZE	2	// Number of overrun/underrun byte offsets logged per session
+
+// Buffer overrun/underrun statistics for the current record/playback session
+typedef struct {
+	uint16_t	overruns;		// Pages the writer could not commit because the reader had not released one
+	uint16_t	underruns;		// Pages the reader needed before the writer had committed them
+	uint32_t	samplesDropped;	// Samples discarded by buffer_queue while overrun
+	uint32_t	samplesHeld;	// Samples repeated by buffer_dequeue while underrun
+	uint32_t	overrunOffset[BUFFER_LOG_SIZE];		// Byte offsets of the first overruns
+	uint32_t	underrunOffset[BUFFER_LOG_SIZE];	// Byte offsets of the first underruns
+} BUFFER_STATS;
+
 // Initialises the buffer for first use. 
-// Users must supply pointers to callback function implementation.
-void buffer_init(void (*pFuncPageFull)(void), void (*pFuncPageEmpty)(void));	
+// Users must supply a memory arena of (pages * pageSize) bytes and the page
+// geometry. The page size must be a power of two.
+void buffer_init(uint8_t* pArena, uint8_t pages, uint16_t pageSize);
 
-void buffer_reset();				// Resets read/write pointers to top of buffer
-void buffer_queue(uint8_t word);	// Writes a sample to the buffer and advances the write pointer
+void buffer_reset();				// Resets read/write pointers to top of buffer and clears statistics
+void buffer_flush();				// Discards every queued page, keeping the session statistics
+uint8_t buffer_queue(uint8_t word);	// Writes a sample to the buffer and advances the write pointer (0 if discarded)
 uint8_t buffer_dequeue();			// Reads a sample from the buffer and advances the read pointer
-uint8_t* buffer_readPage();			// Allows user code to read a full page from the buffer
-uint8_t* buffer_writePage();		// Allows user code to write a full page to the buffer
+void buffer_queueWord(uint16_t word);	// Writes a 16-bit sample (LSB first) to the buffer
+uint16_t buffer_dequeueWord();		// Reads a 16-bit sample (LSB first) from the buffer
+uint8_t* buffer_readPage();			// Returns the oldest full page for user code to read (0 if none)
+void buffer_releasePage();			// Returns a page obtained from buffer_readPage to the buffer
+uint8_t* buffer_writePage();		// Returns the next empty page for user code to write (0 if none)
+void buffer_commitPage();			// Queues a page obtained from buffer_writePage for playback
+uint8_t* buffer_writePages(uint8_t burst, uint8_t* pCount);	// Returns a run of contiguous empty pages for user code to write (0 if too few)
+void buffer_commitPages(uint8_t count);	// Queues pages obtained from buffer_writePages for playback
+void buffer_finish();				// Signals that no more pages will be written this session
+uint8_t buffer_pagesFull();			// Returns the number of full pages currently held in the buffer
+uint8_t buffer_pagesCommitted();	// Returns the number of pages committed by the writer (free running)
+uint8_t buffer_pagesReleased();		// Returns the number of pages released by the reader (free running)
+const BUFFER_STATS* buffer_stats();	// Returns the overrun/underrun statistics for the current session
 
 #endif /* BUFFER_H_ */
\ No newline at end of file
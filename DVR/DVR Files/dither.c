@@ -0,0 +1,238 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+
+/**
+ * dither.c - EGB240DVR Library, Output dither module
+ *
+ * Reduces 16-bit samples to the resolution of the PWM output. Plain
+ * truncation leaves quantisation error correlated with the signal,
+ * heard as distortion on quiet passages. Instead, triangular (TPDF)
+ * dither of +/-1 output LSB decorrelates the error, and first-order
+ * error feedback shapes the resulting noise by (1 - z^-1), moving it
+ * from the audio band towards half the output update rate where the
+ * reconstruction filter removes it.
+ *
+ * Random numbers come from a 16-bit xorshift generator (a linear 
+ * feedback shift register over GF(2) with a full 65535 period); the
+ * two bytes of each output are summed as independent uniform values
+ * to form the triangular distribution. All arithmetic is 16-bit fixed
+ * point in a 14-bit intermediate domain, so the cost per sample is 
+ * constant (no loops or divisions) and safe for the playback ISR.
+ *
+ * The 8-bit quantiser serves mu-law and A-law playback only: the 
+ * samples expanded to 13/14 bits, and those interpolated between them
+ * at variable speed, are reduced to the 8-bit output. 16-bit PCM and
+ * ADPCM use the 10-bit quantiser, and time-stretched output is built
+ * from 8-bit samples and not requantised. Its error is limited to 
+ * +/-2 output LSB while clipping, as for 10-bit.
+ *
+ * Per-sample cost is one generator step (three shift/XOR pairs on a
+ * 16-bit word), three 16-bit additions, a fixed shift, two clamps and
+ * the error update, independent of the sample value. Define 
+ * DITHER_PROFILE to measure it on the target with Timer1 
+ * (dither_maxCycles); the ISR cannot be interrupted, so the figure is
+ * the exact cost of one call. Compare it against the update period,
+ * F_CPU / PLAY_UPDATE_HZ (512 cycles at 31.25 kHz), to budget the ISR.
+ * Estimated by hand from the source (constant shifts unrolled), a 
+ * call takes roughly 110 cycles with its call/return and register 
+ * saves, about a fifth of that period. This is not a measurement; the
+ * DITHER_PROFILE figure from the board supersedes it.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified by: Sid 
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+/************************************************************************/
+/* INCLUDED LIBRARIES/HEADER FILES                                      */
+/************************************************************************/
+#include <avr/io.h>
+
+#include "dither.h"
+
+/************************************************************************/
+/* GLOBAL VARIABLES                                                     */
+/************************************************************************/
+uint16_t ditherState = 0xACE1;	// Random generator state (never zero)
+int16_t ditherError = 0;		// Quantisation error of the last sample (14-bit domain)
+
+#ifdef DITHER_PROFILE
+uint16_t ditherMaxCycles;		// Longest measured requantisation (CPU cycles)
+#endif
+
+/************************************************************************/
+/* PRIVATE/UTILLITY FUNCTIONS                                           */
+/************************************************************************/
+
+/**
+ * Function: dither_random
+ * 
+ * Utility function. Advances the xorshift generator (shifts 7, 9, 8).
+ *
+ * Returns: 16 pseudo-random bits
+ */
+static uint16_t dither_random() {
+	uint16_t x = ditherState;
+	
+	x ^= x << 7;
+	x ^= x >> 9;
+	x ^= x << 8;
+	ditherState = x;
+	
+	return x;
+}
+
+/**
+ * Function: dither_tpdf
+ * 
+ * Utility function. Triangular dither: difference of two independent
+ * uniform bytes.
+ *
+ * Returns: Dither value, -255 to 255 (triangular distribution)
+ */
+static int16_t dither_tpdf() {
+	uint16_t r = dither_random();
+	
+	return (int16_t)(uint8_t)r - (int16_t)(uint8_t)(r >> 8);
+}
+
+#ifdef DITHER_PROFILE
+/**
+ * Function: dither_profile
+ * 
+ * Utility function. Records the cycles taken by a requantisation.
+ *
+ * Parameters:
+ *    start - Timer1 count at the start of the call
+ */
+static void dither_profile(uint16_t start) {
+	uint16_t cycles = TCNT1 - start;
+	
+	if (cycles > ditherMaxCycles)
+		ditherMaxCycles = cycles;
+}
+#endif
+
+/************************************************************************/
+/* PUBLIC/USER FUNCTIONS                                                */
+/************************************************************************/
+
+/**
+ * Function: dither_reset
+ * 
+ * Clears the noise shaping error. Called at the start of playback.
+ */
+void dither_reset() {
+	ditherError = 0;
+	
+#ifdef DITHER_PROFILE
+	TCCR1A = 0x00;	// Normal mode
+	TCCR1B = 0x01;	// Start Timer1, /1 prescaler (counts CPU cycles)
+	ditherMaxCycles = 0;
+#endif
+}
+
+/**
+ * Function: dither_quantise10
+ * 
+ * Requantises a sample to 10 bits with TPDF dither and first-order
+ * noise shaping. The error of each sample (including the dither) is
+ * subtracted from the next sample before it is quantised.
+ *
+ * Parameters:
+ *    sample - Signed 16-bit sample
+ *
+ * Returns: Unsigned 10-bit output value (0 - DITHER_TOP10)
+ */
+uint16_t dither_quantise10(int16_t sample) {
+#ifdef DITHER_PROFILE
+	uint16_t start = TCNT1;
+#endif
+	// 14-bit domain: output LSB is 16, dither is +/-1 LSB
+	int16_t u = (sample >> 2) - ditherError;
+	int16_t q = (u + (dither_tpdf() >> 4) + 8192 + 8) >> 4;	// Round to 10-bit, offset binary
+	
+	if (q < 0)
+		q = 0;
+	else if (q > DITHER_TOP10)
+		q = DITHER_TOP10;
+	
+	ditherError = ((q << 4) - 8192) - u;	// Error fed back into the next sample
+	
+	// Limit the error while clipping (full scale), keeping the loop stable
+	if (ditherError > 32)
+		ditherError = 32;
+	else if (ditherError < -32)
+		ditherError = -32;
+	
+#ifdef DITHER_PROFILE
+	dither_profile(start);
+#endif
+	return q;
+}
+
+/**
+ * Function: dither_quantise8
+ * 
+ * Requantises a sample to 8 bits with TPDF dither and first-order
+ * noise shaping, as dither_quantise10.
+ *
+ * Parameters:
+ *    sample - Signed 16-bit sample
+ *
+ * Returns: Unsigned 8-bit output value (0 - DITHER_TOP8)
+ */
+uint8_t dither_quantise8(int16_t sample) {
+#ifdef DITHER_PROFILE
+	uint16_t start = TCNT1;
+#endif
+	// 14-bit domain: output LSB is 64, dither is +/-1 LSB
+	int16_t u = (sample >> 2) - ditherError;
+	int16_t q = (u + (dither_tpdf() >> 2) + 8192 + 32) >> 6;	// Round to 8-bit, offset binary
+	
+	if (q < 0)
+		q = 0;
+	else if (q > DITHER_TOP8)
+		q = DITHER_TOP8;
+	
+	ditherError = ((q << 6) - 8192) - u;	// Error fed back into the next sample
+	
+	// Limit the error while clipping (full scale), keeping the loop stable
+	if (ditherError > 128)
+		ditherError = 128;
+	else if (ditherError < -128)
+		ditherError = -128;
+	
+#ifdef DITHER_PROFILE
+	dither_profile(start);
+#endif
+	return q;
+}
+
+#ifdef DITHER_PROFILE
+/**
+ * Function: dither_maxCycles
+ * 
+ * Returns: Longest requantisation measured since dither_reset (CPU cycles)
+ */
+uint16_t dither_maxCycles() {
+	return ditherMaxCycles;
+}
+#endif
\ No newline at end of file
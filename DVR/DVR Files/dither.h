@@ -0,0 +1,46 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+/**
+ * dither.h - EGB240DVR Library, Output dither module header
+ *
+ * Requantises 16-bit samples to the PWM output resolution (10-bit, or
+ * 8-bit for sources with more than 8 bits of resolution played on the
+ * 8-bit output) with TPDF dither and error-feedback noise shaping.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified By: Sid
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+#ifndef DITHER_H_
+#define DITHER_H_
+
+#define DITHER_TOP10	1023	// Largest 10-bit output value (Timer4 TOP for 10-bit PWM)
+#define DITHER_TOP8		255		// Largest 8-bit output value
+
+void dither_reset();						// Clears the noise shaping error (start of playback)
+uint16_t dither_quantise10(int16_t sample);	// Dithers/noise shapes a signed 16-bit sample to unsigned 10-bit
+uint8_t dither_quantise8(int16_t sample);	// Dithers/noise shapes a signed 16-bit sample to unsigned 8-bit
+
+#ifdef DITHER_PROFILE
+uint16_t dither_maxCycles();				// Longest measured requantisation (CPU cycles)
+#endif
+
+#endif /* DITHER_H_ */
\ No newline at end of file
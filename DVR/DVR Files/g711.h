@@ -0,0 +1,41 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+/**
+ * g711.h - EGB240DVR Library, G.711 companding module header
+ *
+ * Compands 16-bit samples to/from 8-bit mu-law (WAVE format 7) or
+ * A-law (WAVE format 6) codes using lookup tables.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified By: Sid
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+#ifndef G711_H_
+#define G711_H_
+
+uint8_t g711_ulaw(int16_t sample);		// Compresses a sample to a mu-law code
+uint8_t g711_alaw(int16_t sample);		// Compresses a sample to an A-law code
+uint8_t g711_expandULaw(uint8_t code);	// Expands a mu-law code to an unsigned 8-bit sample
+uint8_t g711_expandALaw(uint8_t code);	// Expands an A-law code to an unsigned 8-bit sample
+int16_t g711_expandULaw16(uint8_t code);	// Expands a mu-law code to a signed 16-bit sample (full resolution)
+int16_t g711_expandALaw16(uint8_t code);	// Expands an A-law code to a signed 16-bit sample (full resolution)
+
+#endif /* G711_H_ */
\ No newline at end of file
@@ -35,8 +35,13 @@ typedef enum {
 DSTATUS disk_initialize (BYTE pdrv);
 DSTATUS disk_status (BYTE pdrv);
 DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
+DRESULT disk_read_ahead (BYTE pdrv, BYTE on);
 #if	_USE_WRITE
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
+DRESULT disk_stream_open (BYTE pdrv, DWORD sector);
+DRESULT disk_stream_close (BYTE pdrv);
+DRESULT disk_write_async (BYTE pdrv, const BYTE* buff, DWORD sector);
+DRESULT disk_poll (BYTE pdrv);
 #endif
 #if	_USE_IOCTL
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
@@ -73,6 +78,7 @@ void disk_timerproc (void);
 #define MMC_GET_CID			52	/* Get CID */
 #define MMC_GET_OCR			53	/* Get OCR */
 #define MMC_GET_SDSTAT		54	/* Get SD status */
+#define MMC_SET_UNROLLED	55	/* Select cycle-counted (1) or polled (0) SPI block transfers */
 
 /* ATA/CF specific command (Not used by FatFs) */
 #define ATA_GET_REV			60	/* Get F/W revision */
@@ -3828,6 +3828,73 @@ FRESULT f_utime (
 
 
 
+#if _USE_EXPAND && !_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* Allocate a Contiguous Blocks to the File                              */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_expand (
+	FIL* fp,		/* Pointer to the file object */
+	DWORD fsz		/* File size to be expanded to */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD n, clst, stcl, scl, ncl, tcl, lclst;
+
+
+	res = validate(fp);						/* Check validity of the object */
+	if (res == FR_OK && fp->err) res = (FRESULT)fp->err;
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+	if (fsz == 0 || fp->fsize != 0 || !(fp->flag & FA_WRITE))	/* Only an empty file can be expanded */
+		LEAVE_FF(fp->fs, FR_DENIED);
+
+	fs = fp->fs;
+	n = (DWORD)fs->csize * SS(fs);			/* Cluster size */
+	tcl = fsz / n + ((fsz & (n - 1)) ? 1 : 0);	/* Number of clusters required */
+	stcl = fs->last_clust;					/* Search from the suggested start point */
+	if (stcl < 2 || stcl >= fs->n_fatent) stcl = 2;
+
+	scl = clst = stcl; ncl = 0;
+	for (;;) {								/* Find a contiguous cluster block */
+		n = get_fat(fs, clst);
+		if (n == 1) { res = FR_INT_ERR; break; }
+		if (n == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+		if (n == 0) {						/* Is it a free cluster? */
+			if (++ncl == tcl) break;		/* Break if a contiguous cluster block is found */
+		} else {
+			ncl = 0;						/* Not a free cluster */
+		}
+		if (++clst >= fs->n_fatent) {		/* Wrap around (block cannot span the end of the FAT) */
+			clst = 2; ncl = 0;
+		}
+		if (ncl == 0) scl = clst;			/* Next block starts here */
+		if (clst == stcl) { res = FR_DENIED; break; }	/* No contiguous cluster block? */
+	}
+
+	if (res == FR_OK) {						/* Create a cluster chain on the FAT */
+		lclst = scl + tcl - 1;
+		for (clst = scl; res == FR_OK && clst < lclst; clst++)
+			res = put_fat(fs, clst, clst + 1);
+		if (res == FR_OK) res = put_fat(fs, lclst, 0x0FFFFFFF);
+		if (res == FR_OK) {
+			fs->last_clust = lclst;			/* Update FSINFO */
+			if (fs->free_clust != 0xFFFFFFFF) {
+				fs->free_clust -= tcl;
+				fs->fsi_flag |= 1;
+			}
+			fp->sclust = scl;				/* Update file object */
+			fp->fsize = fsz;
+			fp->flag |= FA__WRITTEN;
+		}
+	}
+
+	LEAVE_FF(fs, res);
+}
+#endif /* _USE_EXPAND && !_FS_READONLY */
+
+
+
 
 #if _USE_LABEL
 /*-----------------------------------------------------------------------*/
@@ -24,6 +24,8 @@
 #define MMC_WP		0						/* Write protected. yes:true, no:false, default:false */
 #define	FCLK_SLOW()	SPCR = 0x52				/* Set slow clock (F_CPU / 64) */
 #define	FCLK_FAST()	SPCR = 0x50				/* Set fast clock (F_CPU / 2) */
+#define ASYNC_CHUNK	64						/* Bytes sent per disk_poll call in the data phase of an asynchronous write */
+#define SPI_UNROLLED	0					/* Data block transfers: 1:Cycle-counted, 0:Polled (SPIF, default) */
 
 
 /*--------------------------------------------------------------------------
@@ -64,6 +66,32 @@ BYTE Timer1, Timer2;	/* 100Hz decrement timer */
 static
 BYTE CardType;			/* Card type flags */
 
+static
+BYTE SpiUnrolled = SPI_UNROLLED;	/* Cycle-counted data block transfers (MMC_SET_UNROLLED) */
+
+static
+BYTE ReadAhead;			/* Read-ahead mode (0:Off, 1:Armed, 2:CMD18 session open) */
+
+static
+DWORD ReadSector;		/* Next sector (LBA) of the open CMD18 session */
+
+#if _USE_WRITE
+static
+BYTE Stream;			/* Streaming write mode (0:Off, 1:Armed, 2:CMD25 session open) */
+
+static
+DWORD StreamSector;		/* Next sector (LBA) of the open CMD25 session */
+
+static
+BYTE AsyncState;		/* Asynchronous write state (0:Idle, 1:Data phase, 2:Busy phase) */
+
+static
+const BYTE *AsyncPtr;	/* Next byte of the block being written asynchronously */
+
+static
+UINT AsyncCnt;			/* Bytes of the block remaining in the data phase */
+#endif
+
 
 /*-----------------------------------------------------------------------*/
 /* Power Control  (Platform dependent)                                   */
@@ -115,29 +143,100 @@ BYTE xchg_spi (		/* Returns received data */
 }
 
 /* Send a data block fast */
+/* The cycle-counted loop writes SPDR every 18 clocks without polling SPIF  */
+/* (a byte takes 16 clocks at F_CPU / 2). The polled loop loses a few clocks */
+/* per byte between SPIF setting and the next write. An interrupt can only  */
+/* lengthen the gap between bytes, so the timing is safe with interrupts.   */
 static
 void xmit_spi_multi (
 	const BYTE *p,	/* Data block to be sent */
 	UINT cnt		/* Size of data block (must be multiple of 2) */
 )
 {
-	do {
-		SPDR = *p++; loop_until_bit_is_set(SPSR,SPIF);
-		SPDR = *p++; loop_until_bit_is_set(SPSR,SPIF);
-	} while (cnt -= 2);
+	BYTE d;
+
+
+	if (SpiUnrolled) {
+		__asm__ __volatile__ (
+			"ld		%[d], %a[p]+	\n\t"	/* Load first byte */
+			"1:					\n\t"
+			"out	%[spdr], %[d]	\n\t"	/* 1: Start transfer */
+			"ld		%[d], %a[p]+	\n\t"	/* 2: Load next byte */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"nop					\n\t"	/* 1 */
+			"sbiw	%[cnt], 1		\n\t"	/* 2 */
+			"brne	1b				\n\t"	/* 2: 18 clocks per byte (1 on exit) */
+			"rjmp	.+0				\n\t"	/* 2: Margin for SPIF */
+			"in		%[d], %[spsr]	\n\t"	/* Last transfer complete, clear SPIF */
+			"in		%[d], %[spdr]	\n\t"
+			: [d] "=&r" (d), [p] "+e" (p), [cnt] "+w" (cnt)
+			: [spdr] "I" (_SFR_IO_ADDR(SPDR)), [spsr] "I" (_SFR_IO_ADDR(SPSR))
+			: "memory"
+		);
+	} else {
+		do {
+			SPDR = *p++; loop_until_bit_is_set(SPSR,SPIF);
+			SPDR = *p++; loop_until_bit_is_set(SPSR,SPIF);
+		} while (cnt -= 2);
+	}
 }
 
 /* Receive a data block fast */
+/* The cycle-counted loop reads SPDR 19 clocks after starting each byte,   */
+/* 3 clocks after it completes, and starts the next byte at once (20 clocks */
+/* per byte). It has no SPIF check, so it stays off until measured on the   */
+/* target (sdbench); an interrupt only delays the read of a finished byte.  */
 static
 void rcvr_spi_multi (
 	BYTE *p,	/* Data buffer */
 	UINT cnt	/* Size of data block (must be multiple of 2) */
 )
 {
-	do {
-		SPDR = 0xFF; loop_until_bit_is_set(SPSR,SPIF); *p++ = SPDR;
-		SPDR = 0xFF; loop_until_bit_is_set(SPSR,SPIF); *p++ = SPDR;
-	} while (cnt -= 2);
+	BYTE d;
+
+
+	if (SpiUnrolled) {
+		__asm__ __volatile__ (
+			"out	%[spdr], %[ff]	\n\t"	/* Start first transfer */
+			"sbiw	%[cnt], 1		\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2: First read 19 clocks after start */
+			"1:					\n\t"
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"in		%[d], %[spdr]	\n\t"	/* 1: Read received byte */
+			"out	%[spdr], %[ff]	\n\t"	/* 1: Start next transfer */
+			"st		%a[p]+, %[d]	\n\t"	/* 2 */
+			"sbiw	%[cnt], 1		\n\t"	/* 2 */
+			"brne	1b				\n\t"	/* 2: 20 clocks per byte (1 on exit) */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"rjmp	.+0				\n\t"	/* 2 */
+			"nop					\n\t"	/* 1 */
+			"rjmp	.+0				\n\t"	/* 2: Margin for SPIF */
+			"in		%[d], %[spsr]	\n\t"	/* Last transfer complete, clear SPIF */
+			"in		%[d], %[spdr]	\n\t"	/* Read last byte */
+			"st		%a[p]+, %[d]	\n\t"
+			: [d] "=&r" (d), [p] "+e" (p), [cnt] "+w" (cnt)
+			: [spdr] "I" (_SFR_IO_ADDR(SPDR)), [spsr] "I" (_SFR_IO_ADDR(SPSR)), [ff] "r" ((BYTE)0xFF)
+			: "memory"
+		);
+	} else {
+		do {
+			SPDR = 0xFF; loop_until_bit_is_set(SPSR,SPIF); *p++ = SPDR;
+			SPDR = 0xFF; loop_until_bit_is_set(SPSR,SPIF); *p++ = SPDR;
+		} while (cnt -= 2);
+	}
 }
 
 
@@ -302,6 +401,83 @@ BYTE send_cmd (		/* Returns R1 resp (bit7==1:Send failed) */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Stop the open multiple block read session                             */
+/*-----------------------------------------------------------------------*/
+
+static
+void stop_read (void)
+{
+	if (ReadAhead == 2) {	/* Is a CMD18 session open? */
+		send_cmd(CMD12, 0);	/* STOP_TRANSMISSION */
+		deselect();
+		ReadAhead = 1;
+	}
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Stop the open multiple block write session                            */
+/*-----------------------------------------------------------------------*/
+
+#if _USE_WRITE
+static
+int stop_stream (void)	/* 1:Successful, 0:Failed */
+{
+	int ok = 1;
+
+
+	if (Stream == 2) {		/* Is a CMD25 session open? */
+		ok = xmit_datablock(0, 0xFD);	/* STOP_TRAN token */
+		deselect();
+		Stream = 1;
+	}
+
+	return ok;
+}
+#endif
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Complete a pending asynchronous write                                 */
+/*-----------------------------------------------------------------------*/
+
+#if _USE_WRITE
+static
+void flush_async (void)
+{
+	while (AsyncState && disk_poll(0) == RES_NOTRDY) ;
+}
+#endif
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Open a multiple block write session                                   */
+/*-----------------------------------------------------------------------*/
+
+#if _USE_WRITE
+static
+int start_stream (	/* 1:Successful, 0:Failed */
+	DWORD sector	/* Start sector number (LBA) */
+)
+{
+	stop_stream();
+	if (send_cmd(CMD25, (CardType & CT_BLOCK) ? sector : sector * 512) != 0) {	/* WRITE_MULTIPLE_BLOCK (open-ended) */
+		deselect();
+		return 0;
+	}
+	Stream = 2;
+	StreamSector = sector;
+
+	return 1;
+}
+#endif
+
+
+
 /*--------------------------------------------------------------------------
 
    Public Functions
@@ -320,6 +496,10 @@ DSTATUS disk_initialize (
 	BYTE n, cmd, ty, ocr[4];
 
 	if (pdrv) return STA_NOINIT;		/* Supports only single drive */
+	ReadAhead = 0;						/* Any open session is lost */
+#if _USE_WRITE
+	Stream = 0;
+#endif
 	power_off();						/* Turn off the socket power to reset the card */
 	if (Stat & STA_NODISK) return Stat;	/* No card in the socket */
 	power_on();							/* Turn on the socket power */
@@ -395,6 +575,32 @@ DRESULT disk_read (
 	if (pdrv || !count) return RES_PARERR;
 	if (Stat & STA_NOINIT) return RES_NOTRDY;
 
+#if _USE_WRITE
+	flush_async();								/* Complete any asynchronous write */
+	stop_stream();								/* Close any open write session */
+#endif
+
+	if (ReadAhead) {							/* Read-ahead */
+		if (ReadAhead != 2 || sector != ReadSector) {	/* Not contiguous with the open session? */
+			stop_read();						/* Restart the session here */
+			if (send_cmd(CMD18, (CardType & CT_BLOCK) ? sector : sector * 512) != 0) {	/* READ_MULTIPLE_BLOCK (open-ended) */
+				deselect();
+				return RES_ERROR;
+			}
+			ReadAhead = 2;
+		}
+		ReadSector = sector + count;
+		do {
+			if (!rcvr_datablock(buff, 512)) break;
+			buff += 512;
+		} while (--count);
+		if (count) {							/* Abort the session on error */
+			stop_read();
+			return RES_ERROR;
+		}
+		return RES_OK;							/* Session stays open (card selected) */
+	}
+
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert to byte address if needed */
 
 	cmd = count > 1 ? CMD18 : CMD17;			/*  READ_MULTIPLE_BLOCK : READ_SINGLE_BLOCK */
@@ -412,6 +618,30 @@ DRESULT disk_read (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Read-ahead (open-ended multiple block read)                           */
+/*-----------------------------------------------------------------------*/
+/* While read-ahead is on, disk_read pulls sectors from a CMD18 session  */
+/* which is left open between calls, so the card reads ahead into its    */
+/* next block and sequential reads pay no command or access latency. A   */
+/* read of a non-contiguous sector restarts the session there (CMD12 and */
+/* a new CMD18); a write or ioctl stops it.                              */
+
+DRESULT disk_read_ahead (
+	BYTE pdrv,			/* Physical drive nmuber (0) */
+	BYTE on				/* 1:Enable, 0:Disable (stops any open session) */
+)
+{
+	if (pdrv) return RES_PARERR;
+
+	stop_read();
+	ReadAhead = on ? 1 : 0;
+
+	return RES_OK;
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Write Sector(s)                                                       */
 /*-----------------------------------------------------------------------*/
@@ -428,6 +658,25 @@ DRESULT disk_write (
 	if (Stat & STA_NOINIT) return RES_NOTRDY;
 	if (Stat & STA_PROTECT) return RES_WRPRT;
 
+	flush_async();		/* Complete any asynchronous write */
+	stop_read();		/* Close any open read session */
+
+	if (Stream) {		/* Streaming write */
+		if (Stream != 2 || sector != StreamSector) {	/* Not contiguous with the open session? */
+			if (!start_stream(sector)) return RES_ERROR;	/* Restart the session here */
+		}
+		StreamSector += count;
+		do {
+			if (!xmit_datablock(buff, 0xFC)) break;
+			buff += 512;
+		} while (--count);
+		if (count) {	/* Abort the session on error */
+			stop_stream();
+			return RES_ERROR;
+		}
+		return RES_OK;	/* Session stays open (card selected) */
+	}
+
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert to byte address if needed */
 
 	if (count == 1) {	/* Single block write */
@@ -453,6 +702,142 @@ DRESULT disk_write (
 #endif
 
 
+/*-----------------------------------------------------------------------*/
+/* Streaming Write (open-ended multiple block write)                     */
+/*-----------------------------------------------------------------------*/
+/* While streaming, disk_write pushes sectors into a CMD25 session which */
+/* is left open between calls. A write to a non-contiguous sector stops  */
+/* the session (STOP_TRAN token) and opens a new one at that sector; a   */
+/* read or ioctl stops the session. Stop with disk_stream_close.         */
+
+#if _USE_WRITE
+DRESULT disk_stream_open (
+	BYTE pdrv,			/* Physical drive nmuber (0) */
+	DWORD sector		/* Start sector number (LBA) */
+)
+{
+	if (pdrv) return RES_PARERR;
+	if (Stat & STA_NOINIT) return RES_NOTRDY;
+	if (Stat & STA_PROTECT) return RES_WRPRT;
+
+	flush_async();
+	stop_read();
+	Stream = 1;
+	return start_stream(sector) ? RES_OK : RES_ERROR;
+}
+
+
+DRESULT disk_stream_close (
+	BYTE pdrv			/* Physical drive nmuber (0) */
+)
+{
+	int ok;
+
+
+	if (pdrv) return RES_PARERR;
+
+	flush_async();
+	ok = stop_stream();
+	Stream = 0;
+
+	return ok ? RES_OK : RES_ERROR;
+}
+#endif
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Asynchronous Write                                                    */
+/*-----------------------------------------------------------------------*/
+/* disk_write_async starts writing a sector and returns once the data    */
+/* token is sent. The data and busy phases are then advanced by calling  */
+/* disk_poll until it stops returning RES_NOTRDY. The buffer must stay   */
+/* valid until then. Other disk functions complete a pending write.      */
+
+#if _USE_WRITE
+DRESULT disk_write_async (
+	BYTE pdrv,			/* Physical drive nmuber (0) */
+	const BYTE *buff,	/* Pointer to the 512 byte sector to be written */
+	DWORD sector		/* Sector number (LBA) */
+)
+{
+	BYTE token;
+
+
+	if (pdrv) return RES_PARERR;
+	if (Stat & STA_NOINIT) return RES_NOTRDY;
+	if (Stat & STA_PROTECT) return RES_WRPRT;
+	if (AsyncState) return RES_NOTRDY;	/* Previous write in progress */
+	stop_read();						/* Close any open read session */
+
+	if (Stream) {		/* Streaming write, continue or restart the CMD25 session */
+		if (Stream != 2 || sector != StreamSector) {
+			if (!start_stream(sector)) return RES_ERROR;
+		}
+		StreamSector++;
+		token = 0xFC;
+	} else {			/* Single block write */
+		if (send_cmd(CMD24, (CardType & CT_BLOCK) ? sector : sector * 512) != 0) {	/* WRITE_BLOCK */
+			deselect();
+			return RES_ERROR;
+		}
+		token = 0xFE;
+	}
+	if (!wait_ready(500)) {
+		if (Stream) stop_stream(); else deselect();
+		return RES_ERROR;
+	}
+
+	xchg_spi(token);					/* Xmit data token */
+	AsyncPtr = buff;
+	AsyncCnt = 512;
+	AsyncState = 1;
+
+	return RES_OK;
+}
+
+
+DRESULT disk_poll (	/* RES_OK:Idle (write complete), RES_NOTRDY:Write in progress, RES_ERROR:Write failed */
+	BYTE pdrv			/* Physical drive nmuber (0) */
+)
+{
+	if (pdrv) return RES_PARERR;
+
+	switch (AsyncState) {
+	case 1 :	/* Data phase, send a chunk of the data block */
+		xmit_spi_multi(AsyncPtr, ASYNC_CHUNK);
+		AsyncPtr += ASYNC_CHUNK;
+		AsyncCnt -= ASYNC_CHUNK;
+		if (AsyncCnt) return RES_NOTRDY;
+
+		xchg_spi(0xFF);					/* CRC (Dummy) */
+		xchg_spi(0xFF);
+		if ((xchg_spi(0xFF) & 0x1F) != 0x05) break;	/* Data rejected? */
+		AsyncState = 2;
+		Timer2 = 50;					/* Busy timeout of 500ms */
+		return RES_NOTRDY;
+
+	case 2 :	/* Busy phase, check the card once per call */
+		if (xchg_spi(0xFF) != 0xFF) {
+			if (Timer2) return RES_NOTRDY;
+			break;						/* Timeout */
+		}
+		AsyncState = 0;
+		if (Stream != 2) deselect();	/* Single block write complete */
+		return RES_OK;
+
+	default :
+		return RES_OK;
+	}
+
+	AsyncState = 0;						/* Write failed, abort the transfer */
+	if (Stream) stop_stream(); else deselect();
+
+	return RES_ERROR;
+}
+#endif
+
+
 /*-----------------------------------------------------------------------*/
 /* Miscellaneous Functions                                               */
 /*-----------------------------------------------------------------------*/
@@ -475,6 +860,12 @@ DRESULT disk_ioctl (
 
 	if (Stat & STA_NOINIT) return RES_NOTRDY;
 
+#if _USE_WRITE
+	flush_async();		/* Complete any asynchronous write */
+	stop_stream();		/* Close any open write session (completes pending writes) */
+#endif
+	stop_read();		/* Close any open read session */
+
 	switch (cmd) {
 	case CTRL_SYNC :		/* Make sure that no pending write process. Do not remove this or written sector might not left updated. */
 		if (select()) res = RES_OK;
@@ -550,6 +941,11 @@ DRESULT disk_ioctl (
 		}
 		break;
 
+	case MMC_SET_UNROLLED :	/* Select SPI block transfer loop (1 byte) */
+		SpiUnrolled = *ptr;
+		res = RES_OK;
+		break;
+
 	case CTRL_POWER_OFF :	/* Power off */
 		power_off();
 		Stat |= STA_NOINIT;
@@ -28,12 +28,36 @@ limitations under the License.
  * memory on an SD card (using the FAT file system and WAVE file
  * format. 
  *
- * This skeleton code provides a recording implementation which 
- * samples CH0 of the ADC at 8-bit, 15.625kHz. Samples are stored 
- * in flash memory on an SD card in the WAVE file format. The 
- * filename is set to "EGB240.WAV". The SD card must be formatted 
- * with the FAT file system. Recorded WAVE files are playable on 
- * a computer.
+ * This skeleton code records CH0 of the ADC (8-bit PCM at 15.625 kHz 
+ * by default) to "EGB240.WAV" on a FAT formatted SD card, and plays 
+ * it back (or the files listed in PLAYLIST.TXT, see playlist.c) 
+ * through PWM. Recorded WAVE files are playable on a computer.
+ *
+ * Buttons:
+ *   S1  - Play; seek back PLAY_SEEK_SECONDS while playing
+ *   S2  - Record; seek forward PLAY_SEEK_SECONDS while playing
+ *   S3  - Stop
+ *   PB4 - Cycle the playback speed (1x, 1.5x, 2x, 3x, 0.5x); hold to
+ *         set A-B loop point A, then B, then clear the loop (loops of
+ *         up to 3 pages, about 0.1 s, replay from RAM: dvr_loopCached)
+ *
+ * Serial console keys while stopped:
+ *   '1' - '5' - Recording sample rate (8 - 31.25 kHz; about 8-bit 
+ *               resolution at 22.05 and 31.25 kHz, see adc_setRate)
+ *   'b' - Recording format (8/16-bit PCM, IMA ADPCM, mu-law, A-law)
+ *   'o' - 2x oversampling (8 kHz only)
+ *   't' - Pitch-preserving time-stretch for playback
+ *   'd' - Dithered or truncated playback of 16-bit sources
+ *   'r' - Resampler benchmark (built with RESAMPLE_BENCHMARK)
+ *   'k' - SD card benchmark (built with SD_BENCHMARK)
+ *
+ * Serial console keys while playing:
+ *   '+'/'-' - Playback speed in 1/16x steps
+ *   'v' - Reverse the direction of playback
+ *
+ * The sampling, playback and file features are described in the 
+ * headers of the adc, timer, wave, resample, stretch, dither and
+ * playlist modules, and at the dvr_xxx functions below.
  * 
  * LED4 on the TeensyBOBv2 is configured to flash as an 
  * indicator that the programme is running; a 1 Hz, 50 % duty
@@ -53,21 +77,69 @@ limitations under the License.
  /************************************************************************/
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
 
 #include <stdio.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "serial.h"
 #include "timer.h"
 #include "wave.h"
 #include "buffer.h"
 #include "adc.h"
+#include "adpcm.h"
+#include "g711.h"
+#include "sdbench.h"
+#include "stretch.h"
+#include "dither.h"
+#include "resample.h"
+#include "playlist.h"
 #include "lib/fatfs/ff.h"
 #include "lib/fatfs/diskio.h"
 
 #define TOP 255
 
+#define BUFFER_PAGES		3		// Number of pages in the circular buffer
+#define BUFFER_PAGE_SIZE	512		// Size of each buffer page (bytes), whole sectors transfer directly to/from SD card
+#define RECORD_SECONDS_MAX	300		// Maximum record time - 5 min
+
+#define ADC_TRIGGER_MAX		18000UL	// Fastest ADC trigger rate when oversampling (250 kHz ADC clock)
+#define ADC_OVERSAMPLE		1		// log2 of the oversampling ratio selected with key 'o' (2x, within ADC_TRIGGER_MAX at 8 kHz only)
+
+#define PLAY_CARRIER_HZ		250000UL	// Timer4 PWM carrier frequency (64 MHz PLL / 256)
+#define PLAY_CARRIER10_HZ	62500UL		// Timer4 PWM carrier frequency for 10-bit output (64 MHz PLL / 1024)
+#define PLAY_UPDATE_HZ		31250	// Playback output update (Timer3 CMPA) frequency, independent of the carrier
+#define PLAY_PHASE_ONE		0x4000	// Playback phase accumulator increment for one sample per update
+#define PLAY_STAGE_SIZE		(BUFFER_PAGE_SIZE / 2)	// File bytes staged per resampler pass (the filter history follows them)
+#define PLAY_BURST_PAGES	1		// Minimum pages read from the SD card per transfer during playback (fewer at the bottom of the buffer)
+#define PLAY_SEEK_SECONDS	5		// Playback seek step, back with S1 and forward with S2
+
+#define PLAY_SPEED_ONE		16		// Playback speed of 1x (speeds are set in 1/16 steps)
+#define PLAY_SPEED_MIN		8		// Slowest playback speed (0.5x)
+#define PLAY_SPEED_MAX		48		// Fastest playback speed (3x)
+#define PLAY_SPEED_PRESETS	5		// Number of speeds cycled with PB4
+#define PLAY_HOLD_TICKS		(PLAY_UPDATE_HZ / 2)	// PB4 hold that steps the A-B loop (output updates, 0.5 s)
+#define PLAY_SPLICE_SHIFT	5		// log2 of the loop splice ramp length (samples)
+#define STACK_CANARY		0xC5	// Fill byte of RAM above .bss at reset, the stack's low-water mark is where it ends
+
+// IMA ADPCM blocks are encoded/decoded in place, one block per buffer page
+#if BUFFER_PAGE_SIZE != ADPCM_BLOCK_SIZE
+#error "BUFFER_PAGE_SIZE must equal ADPCM_BLOCK_SIZE"
+#endif
+
+// The time-stretch stage borrows the last buffer page as its work area
+#if STRETCH_WORK_SIZE > BUFFER_PAGE_SIZE
+#error "STRETCH_WORK_SIZE must fit in a buffer page"
+#endif
+
+// The resampler stages half a file page in the last buffer page, followed by its history
+#if PLAY_STAGE_SIZE + RESAMPLE_WORK_SIZE > BUFFER_PAGE_SIZE
+#error "PLAY_STAGE_SIZE + RESAMPLE_WORK_SIZE must fit in a buffer page"
+#endif
+
 /************************************************************************/
 /* ENUM DEFINITIONS                                                     */
 /************************************************************************/
@@ -77,17 +149,62 @@ enum {
 	DVR_PLAYING
 };
 
+/************************************************************************/
+/* LOOKUP TABLES                                                        */
+/************************************************************************/
+
+// WAVE format tag and bits per sample of each sample format (ADC_FORMAT_xxx)
+const uint16_t formatTags[ADC_FORMAT_COUNT] PROGMEM = {
+	WAVE_FORMAT_PCM, WAVE_FORMAT_PCM, WAVE_FORMAT_IMA_ADPCM, WAVE_FORMAT_MULAW, WAVE_FORMAT_ALAW
+};
+const uint8_t formatBits[ADC_FORMAT_COUNT] PROGMEM = {
+	8, 16, 4, 8, 8
+};
+
+// Playback speeds cycled with PB4 (1x, 1.5x, 2x, 3x, 0.5x)
+const uint8_t speedPresets[PLAY_SPEED_PRESETS] PROGMEM = {
+	16, 24, 32, 48, 8
+};
+
 /************************************************************************/
 /* GLOBAL VARIABLES                                                     */
 /************************************************************************/
+uint8_t samples[BUFFER_PAGES * BUFFER_PAGE_SIZE];	// Circular buffer memory (arena)
+
 volatile uint16_t countpage = 0;
-volatile uint16_t pageCount = 0;	// Page counter - used to terminate recording
-volatile uint16_t newPage = 0;	// Flag that indicates a new page is available for read/write
+volatile uint16_t pageCount = 0;	// Page counter - used to terminate recording/playback
+uint16_t playPages = 0;			// Number of pages of sample data being played (seek range)
+WAVE_INFO playInfo;				// Format and data extent of the WAVE file being played
+uint8_t playResample = 0;		// Flag that indicates file pages are resampled into the buffer (through a staging page)
+uint8_t playPagesIn = 1;		// File pages per buffer page
+uint8_t playReverse = 0;		// Flag that indicates the file is played backwards (selected with key 'v')
+uint8_t playNext = 0;			// Flag that indicates the next file of the playlist is open, played once the buffer drains (format differs)
+uint8_t playRingPages = BUFFER_PAGES;	// Pages of the ring buffer fed from the file
+uint8_t loopState = 0;			// A-B loop state (0: off, 1: A set, 2: looping from B to A)
+uint16_t loopA, loopB;			// A-B loop start and end (file page boundaries)
+uint8_t loopPass = 0;			// Loop wraps so far (2: the last pass is held in the ring buffer)
+volatile uint8_t spliceMask = 0;	// Pages (buffer page count modulo 8) that start at a loop splice
+uint8_t spliceCount = 0;		// Samples of splice ramp remaining (ISR)
+int32_t spliceOffset;			// Step between the samples either side of the splice (ISR)
+volatile uint16_t holdTicks;	// Output updates since PB4 was pressed (saturating)
+uint8_t PB4_held = 0;			// Flag that indicates the current PB4 press has been held (A-B loop)
 volatile uint8_t stop = 0;		// Flag that indicates playback/recording is complete
-volatile uint8_t ticks = 0;
-volatile uint8_t number  = 2;
+volatile uint16_t phase = 0;	// Playback phase accumulator, a sample is output each PLAY_PHASE_ONE
+volatile uint16_t step = PLAY_PHASE_ONE / 2;	// Playback phase increment per output update
+uint16_t baseStep = PLAY_PHASE_ONE / 2;	// Phase increment at normal speed for the playback sample rate
+uint8_t recordFormat = ADC_FORMAT_PCM8;	// Selected recording sample format (ADC_FORMAT_xxx)
+uint8_t sampleRate = TIMER_RATE_15625;	// Selected recording sample rate (TIMER_RATE_xxx)
+uint8_t oversample = 0;			// Selected oversampling (log2 of ratio, 0 for none)
+volatile uint8_t playFormat = ADC_FORMAT_PCM8;	// Sample format being played (ADC_FORMAT_xxx)
 uint8_t check = 0;
-volatile uint8_t fast = 0;
+uint8_t speedPreset = 0;		// Index of the playback speed preset selected with PB4
+uint8_t playSpeed = PLAY_SPEED_ONE;	// Playback speed (1/16 x)
+int16_t playPrev = 0x80;		// Previous output sample (interpolation start; unsigned 8-bit, or signed 16-bit if playWide)
+int16_t playCur = 0x80;			// Current output sample (interpolation end)
+volatile uint8_t playHiRes = 0;	// Flag that indicates 16-bit samples are played through 10-bit PWM
+volatile uint8_t playWide = 0;	// Flag that indicates samples are handled as signed 16-bit and requantised for output
+uint8_t playDither = 1;			// Dithered/noise shaped requantisation selected with key 'd' (truncation if off)
+uint8_t timeStretch = 0;		// Pitch-preserving time-stretch selected with key 't'
 
 //FATFS fs2;
 //FIL file2;
@@ -102,13 +219,22 @@ volatile uint8_t push_button_stable=0;
 uint8_t push_buttons = 0;
 uint8_t PB3_val = 0;
 uint8_t PB4_val = 0, prev_PB4_val = 0, PB4_edge = 0;
+uint8_t PB1_val = 0, prev_PB1_val = 0, PB1_edge = 0;
+uint8_t PB2_val = 0, prev_PB2_val = 0, PB2_edge = 0;
 
 /************************************************************************/
 /* FUNCTION PROTOTYPES                                                  */
 /************************************************************************/
-void pageFull();
-void pageEmpty();
 void PwM_start();
+void dvr_report(uint8_t bits);
+uint16_t stack_unused();
+void dvr_setSpeed(uint8_t speed);
+void dvr_loop();
+void dvr_start();
+uint8_t dvr_next();
+static inline uint8_t play_sample();
+static inline int16_t play_sample16();
+static inline void play_splice();
 //void debounce();
 //void debounce_init();
 /************************************************************************/
@@ -133,8 +259,9 @@ void init() {
 		pll_init();     // Configure PLL (used by Timer4 and USB serial)
 		serial_init();	// Initialise USB serial interface (debug)
 		timer_init();	// Initialise timer (used by FatFs library)
-		buffer_init(pageFull, pageEmpty);  // Initialise circular buffer (must specify callback functions)
+		buffer_init(samples, BUFFER_PAGES, BUFFER_PAGE_SIZE);  // Initialise circular buffer (must specify memory arena)
 		adc_init();		// Initialise ADC
+		set_sleep_mode(SLEEP_MODE_IDLE);	// Idle between SD card transfers (timers keep running)
 		sei();			// Enable interrupts
 	    DDRF &= 0b10001111;    // Pushbuttons 1 to 3 - PORTF 6-4 as inputs
 	    DDRD |= 0b11110000;		// Set PORTD 7-4 as outputs (LEDs)	
@@ -143,36 +270,6 @@ void init() {
 		wave_init();	// Initialise WAVE file interface
 }
 
-/************************************************************************/
-/* CALLBACK FUNCTIONS FOR CIRCULAR BUFFER                               */
-/************************************************************************/
-
-// CALLED FROM BUFFER MODULE WHEN A PAGE IS FILLED WITH RECORDED SAMPLES
-void pageFull() 
-{
-	if(!(--pageCount)) 
-	{
-		// If all pages have been filled
-		adc_stop();		// Stop recording (disable new ADC conversions)
-		stop = 1;		// Flag recording complete
-	}
-
-	else 
-		newPage = 1;	// Flag new page is ready to write to SD card
-}
-
-// CALLED FROM BUFFER MODULE WHEN A NEW PAGE HAS BEEN EMPTIED
-void pageEmpty() 
-{
-		if(!(--pageCount)) // If all pages have been read.
-		stop = 1;		// Flag playback complete
-	
-
-	else 
-		newPage = 1;	// Flag new page is ready to read to buffer.
-
-}
-
 // FOR STORING THE LAST PAGE IN CASE OF FORCE STOP, WHILE RECORDING.
 /*
 void write_file(uint16_t* lastpage, uint16_t c)
@@ -213,6 +310,14 @@ void debounce_init()
 	push_buttons = 0;
 	PB3_val = 0;
 	PB4_val = 0, prev_PB4_val = 0, PB4_edge = 0;
+	PB4_held = 1;	// No action until PB4 is next pressed
+	
+	// S1/S2 may still be held from starting playback, only new presses seek
+	push_buttons = ~PINF;
+	prev_PB1_val = push_buttons & 0b00010000;
+	prev_PB2_val = push_buttons & 0b00100000;
+	PB1_edge = 0;
+	PB2_edge = 0;
 
 }
 
@@ -223,6 +328,8 @@ void debounce()
 
 	PB3_val = push_buttons & 0b01000000;
 	PB4_val = push_buttons & 0b10000000;
+	PB1_val = push_buttons & 0b00010000;
+	PB2_val = push_buttons & 0b00100000;
 
 	//reset if PB3 pressed
 	//if (PB3_val != 0)
@@ -234,54 +341,593 @@ void debounce()
 	//PORTD |= 0b00010000;  // turn LED1 on
 	//PORTD &= 0b00011111;  // turn other LEDs off
 		
-	if (PB4_edge && (fast == 0))
-		{fast = 1; number = 1; ticks = 0; PORTD |= 0b10000000; }
-		
-	else if (PB4_edge && (fast == 1))
-		{fast = 0; number = 2; ticks = 0; PORTD &= 0b01111111;}
+	// PB4 held steps the A-B loop, a short press (on release) cycles the speed
+	if (PB4_edge)
+	{
+		cli();
+		holdTicks = 0;
+		sei();
+		PB4_held = 0;
+	}
+	else if (PB4_val && !PB4_held && (holdTicks >= PLAY_HOLD_TICKS))
+	{
+		PB4_held = 1;
+		dvr_loop();
+	}
+	else if (!PB4_val && prev_PB4_val && !PB4_held)
+	{
+		speedPreset = (speedPreset + 1) % PLAY_SPEED_PRESETS;	// Next speed
+		dvr_setSpeed(pgm_read_byte(&speedPresets[speedPreset]));
+	}
 
 	prev_PB4_val = PB4_val;
+	
+	//find presses of S1/S2 (seek back/forward)
+	PB1_edge = ((prev_PB1_val == 0) && (PB1_val != 0));
+	PB2_edge = ((prev_PB2_val == 0) && (PB2_val != 0));
+	prev_PB1_val = PB1_val;
+	prev_PB2_val = PB2_val;
 
 }
 /************************************************************************/
 /* RECORD/PLAYBACK ROUTINES                                             */
 /************************************************************************/
 
+// Selects the sample rate and oversampling for recording (Timer0 trigger, ADC clock, decimator)
+void dvr_setRate(uint8_t rate, uint8_t shift)
+{
+	timer_setRate(rate, 0);
+	
+	// Reduce the ratio until the ADC clock can stay at full accuracy for the trigger rate and
+	// the oversampled period is not rounded (the header holds the rate of the undivided period)
+	while (shift && ((((uint32_t)timer_getRate() << shift) > ADC_TRIGGER_MAX) || !timer_divides(shift)))
+		shift--;
+	
+	sampleRate = rate;
+	oversample = shift;
+	timer_setRate(rate, shift);
+	adc_setOversample(shift);
+	adc_setRate(timer_getRate() << shift);
+	printf_P(PSTR("Sample rate: %u Hz, oversampling: %ux\n"), timer_getRate(), 1 << shift);
+}
+
+// Cycles the recording sample format (8-bit PCM, 16-bit PCM, IMA ADPCM, mu-law, A-law)
+void dvr_nextFormat()
+{
+	recordFormat = (recordFormat + 1) % ADC_FORMAT_COUNT;
+	printf_P(PSTR("WAVE format: 0x%02x, bits per sample: %u\n"), 
+		pgm_read_word(&formatTags[recordFormat]), pgm_read_byte(&formatBits[recordFormat]));
+}
+
 // Initiates a record cycle
 void dvr_record() 
 {  
-	buffer_reset();		// Reset buffer state
+	uint8_t bits = pgm_read_byte(&formatBits[recordFormat]);
+	
+	buffer_init(samples, BUFFER_PAGES, BUFFER_PAGE_SIZE);	// Reset buffer state (every page, after time-stretch playback)
 	countpage = 0;
-	pageCount = 900;	// Maximum record time - 30 sec
-	newPage = 0;		// Clear new page flag
+	pageCount = (uint16_t)((uint32_t)RECORD_SECONDS_MAX * timer_getRate() * bits / 8 / BUFFER_PAGE_SIZE);	// Maximum record time
 	
-	wave_create();		// Create new wave file on the SD card
+	adpcm_reset();		// Start a new ADPCM block
+	adc_setFormat(recordFormat);	// Select ADC sample format
+	wave_create(timer_getRate(), pgm_read_word(&formatTags[recordFormat]), bits, (uint32_t)pageCount * BUFFER_PAGE_SIZE);	// Create new wave file on the SD card (contiguous)
 	adc_start();		// Begin sampling
 	PORTD |= 0b01100000;
 }
 
+// Returns the number of pages holding a number of bytes of sample data (the last page padded with silence)
+uint16_t dvr_pages(uint32_t bytes)
+{
+	uint32_t pages = (bytes + BUFFER_PAGE_SIZE - 1) / BUFFER_PAGE_SIZE;
+	
+	return (pages > 0xFFFF) ? 0xFFFF : (uint16_t)pages;
+}
+
+// Reads count bytes forward from the WAVE file, completing n pages (at most pageCount): whole
+// pages, or a page in two halves of which only the second completes it
+// The last page of a file in a playlist is completed from the start of the next file (at a block
+// boundary, so ADPCM blocks stay aligned) when the formats match: the files play back to back
+// without a gap. The next file is opened and its header parsed while the buffered pages play
+void dvr_readPages(uint8_t* page, uint16_t count, uint8_t n)
+{
+	uint16_t align = playInfo.blockAlign ? playInfo.blockAlign : 1;
+	uint16_t pending = n ? 0 : BUFFER_PAGE_SIZE - count;	// Rest of a page read in halves
+	uint32_t left = wave_remaining();	// Bytes of the file in the pages, the rest is silence
+	uint32_t next;
+	
+	wave_read(page, count);
+	pageCount -= n;
+	
+	while ((left <= count) && !loopState && playlist_hasNext() && dvr_next()) {
+		left = (left + align - 1) / align * align;
+		next = wave_remaining();
+		if ((left < count) && next)
+			wave_read(page + left, count - left);	// Next file's first samples
+		left += next;	// Past count unless the next file ends in these pages too
+		pageCount = dvr_pages(wave_remaining() + pending);
+	}
+}
+
+// Fills a buffer page with resampled samples, converting file pages in halves through the 
+// staging page (the last page of the arena, which also holds the filter history); the end
+// of the file is padded with silence
+// No page past the end of an A-B loop is read (dvr_loop keeps B on a buffer page boundary)
+void dvr_resample(uint8_t* page)
+{
+	uint8_t* stage = samples + (BUFFER_PAGES - 1) * BUFFER_PAGE_SIZE;
+	uint16_t n = 0;
+	uint8_t last;
+	
+	// Each file page converts to a whole fraction of a buffer page (1, 1/2 or 1/4)
+	while (pageCount && (n < BUFFER_PAGE_SIZE) && !((loopState == 2) && (playPages - pageCount >= loopB))) {
+		for (last = 0; (last < 2) && pageCount; last++) {
+			if (playReverse) {
+				wave_readBack(stage, PLAY_STAGE_SIZE);
+				pageCount -= last;
+			} else {
+				dvr_readPages(stage, PLAY_STAGE_SIZE, last);
+			}
+			n += resample_process(stage, PLAY_STAGE_SIZE, page + n);
+		}
+	}
+	memset(page + n, 0, BUFFER_PAGE_SIZE - n);
+}
+
+// Moves the reader from the end of the A-B loop back to its start (a constant-time seek through
+// the cluster link map); the ISR ramps into the first of the next count pages committed
+void dvr_loopWrap(uint8_t count)
+{
+	uint8_t splice = buffer_pagesCommitted() + count;
+	
+	wave_seek((uint32_t)loopA * BUFFER_PAGE_SIZE);
+	pageCount = playPages - loopA;
+	if (loopPass < 2)
+		loopPass++;
+	
+	if (!timeStretch) {
+		cli();
+		spliceMask |= 1 << (splice & 7);
+		sei();
+	}
+}
+
+// Reads a page of a short A-B loop from the ring buffer: once a whole pass of the loop has
+// been read, the copy of each page made loopB - loopA pages earlier is still in the ring
+// Only loops of up to playRingPages pages are cached (3, or 2 with time-stretch: 1.5 KB or 1 KB,
+// about 0.1 s of 8-bit 15.625 kHz audio); longer and resampled loops are read again each pass
+uint8_t dvr_loopCached(uint8_t* page)
+{
+	uint16_t length = loopB - loopA;
+	uint8_t* source = page - length * BUFFER_PAGE_SIZE;
+	
+	if (source < samples)
+		source += playRingPages * BUFFER_PAGE_SIZE;
+	if (source != page)
+		memcpy(page, source, BUFFER_PAGE_SIZE);	// Loop shorter than the ring
+	pageCount--;
+	return 1;
+}
+
+// Reads up to n empty buffer pages from the WAVE file (one multi-sector read, or
+// a page through the resampler), returns the number of pages read
+// Backwards, the pages preceding the read position are read and reversed as one block
+// An A-B loop wraps after its last page; short loops are served from the ring buffer
+uint8_t dvr_read(uint8_t* page, uint8_t n)
+{
+	if (playResample) {
+		dvr_resample(page);
+		n = 1;
+	} else if ((loopState == 2) && (loopPass >= 2) && (loopB - loopA <= playRingPages)) {
+		n = dvr_loopCached(page);
+	} else {
+		if (n > pageCount)
+			n = pageCount;
+		if ((loopState == 2) && (n > loopB - (playPages - pageCount)))
+			n = loopB - (playPages - pageCount);	// Stop at the end of the loop
+		if (playReverse) {
+			wave_readBack(page, n * BUFFER_PAGE_SIZE);
+			pageCount -= n;
+		} else {
+			dvr_readPages(page, n * BUFFER_PAGE_SIZE, n);
+		}
+	}
+	
+	if ((loopState == 2) && (playPages - pageCount >= loopB))
+		dvr_loopWrap(n);
+	return n;
+}
+
+// Fills every empty page of the buffer from the WAVE file
+void dvr_fill()
+{
+	uint8_t* page;
+	uint8_t n;
+	
+	while (pageCount && (page = buffer_writePages(1, &n))) {
+		buffer_commitPages(dvr_read(page, n));
+		if (!pageCount)
+			buffer_finish();	// Rest of recording fits in the buffer
+	}
+}
+
+// Opens a WAVE file for playback, describing it in playInfo
+// Returns WAVE_OK, or WAVE_ERR_xxx if the file cannot be played (nothing is played from it)
+uint8_t dvr_open(const char* pName)
+{
+	uint8_t status;
+	
+	printf_P(PSTR("%s: "), pName);
+	status = wave_open(pName, &playInfo);
+	if (status == WAVE_OK)
+		printf_P(PSTR("%lu Hz, %u-bit, %u channel(s), format 0x%x, %lu bytes\n"), playInfo.sampleRate, 
+			playInfo.bitsPerSample, playInfo.channels, playInfo.format, playInfo.dataSize);
+	else
+		playInfo.dataSize = 0;	// Nothing to play
+	
+	return status;
+}
+
+// Opens the next file of the playlist in place of the file read to its end (its last pages are
+// still in the buffer); returns true if its samples continue the buffer (same format, rate and
+// block size) or it cannot be played (skipped), otherwise it is played once the buffer drains
+// Runs inside the page read at the deepest point of playback, so only the stream format is kept
+// on the stack (not a copy of playInfo)
+uint8_t dvr_next()
+{
+	uint32_t rate = playInfo.sampleRate;
+	uint16_t format = playInfo.format;
+	uint16_t blockAlign = playInfo.blockAlign;
+	uint8_t channels = playInfo.channels;
+	uint8_t bits = playInfo.bitsPerSample;
+	
+	// The playlist is read with the file object of the WAVE module, once the file is closed
+	wave_close();
+	playlist_advance();
+	if (dvr_open(playlist_name()) != WAVE_OK) {
+		playInfo.sampleRate = rate;	// Stream format unchanged
+		playInfo.format = format;
+		playInfo.blockAlign = blockAlign;
+		playInfo.channels = channels;
+		playInfo.bitsPerSample = bits;
+		pageCount = 0;
+		return 1;
+	}
+	
+	if ((playInfo.format != format) || (playInfo.channels != channels) || 
+		(playInfo.bitsPerSample != bits) || (playInfo.sampleRate != rate) || 
+		(playInfo.blockAlign != blockAlign)) {
+		playNext = 1;	// Output restarts for the new format
+		pageCount = 0;
+		return 0;
+	}
+	
+	// Seeks and loops are within the new file
+	pageCount = dvr_pages(playInfo.dataSize);
+	playPages = pageCount;
+	return 1;
+}
+
+// Initiates playback: of the files listed in the playlist file in turn, or of the recording
 void dvr_play()
 {  
-	buffer_reset();
-	//volatile uint16_t pageBreak = read_file();
-   // if (page_break > 0)
-    //	pageCount = page_break;
-    
-   // else
-    	pageCount = countpage;
-	    fast = 0;
-	    number = 2;
-	    ticks = 0;
     PORTD |= 0b00010000;
-    wave_open();
-	wave_read(buffer_writePage(), 1024);
-	newPage = 0;
+	
+	playNext = 0;
+	playlist_start();
+	dvr_open(playlist_name());
+	dvr_start();
+}
+
+// Starts the output for the file described in playInfo (opened with dvr_open), filling the buffer
+// from its first page
+void dvr_start()
+{
+	uint32_t rate;
+	
+	// Play the sample data located in the file (any length, including files authored off-device)
+	pageCount = dvr_pages(playInfo.dataSize);
+	playResample = 0;
+	playPagesIn = 1;
+	playReverse = 0;
+	loopState = 0;
+	spliceMask = 0;
+	spliceCount = 0;
+	
+	// Stereo PCM and PCM above the update rate are converted to 16-bit mono as pages are read
+	if (pageCount) {
+		playResample = (playInfo.format == WAVE_FORMAT_PCM) && 
+			((playInfo.channels > 1) || (playInfo.sampleRate > PLAY_UPDATE_HZ));
+		if (!playResample && (playInfo.channels > 1)) {
+			printf_P(PSTR("Unsupported channel count: %u\n"), playInfo.channels);
+			pageCount = 0;
+		}
+	}
+	
+	rate = playInfo.sampleRate;
+	if (playResample) {
+		uint8_t factor = (rate > PLAY_UPDATE_HZ) ? 2 : 1;
+		resample_init(samples + (BUFFER_PAGES - 1) * BUFFER_PAGE_SIZE + PLAY_STAGE_SIZE, playInfo.channels, playInfo.bitsPerSample, factor);
+		playPagesIn = playInfo.blockAlign * factor / 2;	// 16-bit output per input frame consumed
+		rate /= factor;
+		if (timeStretch) {
+			// The staging page is the time-stretch work area
+			timeStretch = 0;
+			printf_P(PSTR("Time-stretch: off (resampled file)\n"));
+		}
+	}
+	
+	playRingPages = (timeStretch || playResample) ? BUFFER_PAGES - 1 : BUFFER_PAGES;
+	if (timeStretch) {
+		// Two pages feed the time-stretch stage, the last page is its work area
+		buffer_init(samples, BUFFER_PAGES - 1, BUFFER_PAGE_SIZE);
+		stretch_init(samples + (BUFFER_PAGES - 1) * BUFFER_PAGE_SIZE, play_sample);
+	} else if (playResample) {
+		// Two pages feed the ISR, the last page stages file half-pages and the history for the resampler
+		buffer_init(samples, BUFFER_PAGES - 1, BUFFER_PAGE_SIZE);
+	} else {
+		buffer_init(samples, BUFFER_PAGES, BUFFER_PAGE_SIZE);
+	}
+	
+	// Timer3 updates the output at PLAY_UPDATE_HZ, step the phase at the sample rate
+	// (decimated by the resampler above it; rates over twice the update rate play slow)
+	if (!rate || (rate > PLAY_UPDATE_HZ))
+		rate = PLAY_UPDATE_HZ;
+	baseStep = (uint16_t)(rate * PLAY_PHASE_ONE / PLAY_UPDATE_HZ);
+	
+	// Select decoder for the file's sample format
+	switch (playInfo.format) {
+		case WAVE_FORMAT_IMA_ADPCM:
+			playFormat = ADC_FORMAT_ADPCM;
+			if (playInfo.blockAlign != ADPCM_BLOCK_SIZE) {
+				// ADPCM blocks must match the buffer pages
+				printf_P(PSTR("Unsupported ADPCM block size: %u\n"), playInfo.blockAlign);
+				pageCount = 0;
+			}
+			break;
+		case WAVE_FORMAT_MULAW:
+			playFormat = ADC_FORMAT_ULAW;
+			break;
+		case WAVE_FORMAT_ALAW:
+			playFormat = ADC_FORMAT_ALAW;
+			break;
+		default:
+			playFormat = ((playInfo.bitsPerSample == 16) || playResample) ? ADC_FORMAT_PCM16 : ADC_FORMAT_PCM8;
+			break;
+	}
+	adpcm_reset();
+	speedPreset = 0;
+	dvr_setSpeed(PLAY_SPEED_ONE);
+	phase = 0;
+	
+	// 16-bit sources play through 10-bit PWM (time-stretch output is 8-bit)
+	playHiRes = ((playFormat == ADC_FORMAT_PCM16) || (playFormat == ADC_FORMAT_ADPCM)) && !timeStretch;
+	// Companded samples expand to 13/14 bits, dithered to the 8-bit output
+	playWide = playHiRes || 
+		(playDither && !timeStretch && ((playFormat == ADC_FORMAT_ULAW) || (playFormat == ADC_FORMAT_ALAW)));
+	playPrev = playWide ? 0 : 0x80;	// Silence
+	playCur = playPrev;
+	dither_reset();
+
+	playPages = pageCount;
+	
+	// Fill every page of the buffer before playback begins
+	dvr_fill();
 	PwM_start();
 	debounce_init();
 	debounce();
 
 }
 
+// Sets the playback speed (1/16 x, PLAY_SPEED_MIN - PLAY_SPEED_MAX), PB4 LED lit away from 1x
+// Pitch follows speed unless time-stretching (STRETCH_SPEED_MIN - STRETCH_SPEED_MAX, ISR plays at 1x);
+// the SD card is read as fast as the buffer empties
+void dvr_setSpeed(uint8_t speed)
+{
+	uint16_t s;
+	uint8_t min = timeStretch ? STRETCH_SPEED_MIN : PLAY_SPEED_MIN;
+	uint8_t max = timeStretch ? STRETCH_SPEED_MAX : PLAY_SPEED_MAX;
+	
+	if (speed < min)
+		speed = min;
+	if (speed > max)
+		speed = max;
+	playSpeed = speed;
+	
+	if (timeStretch) {
+		stretch_setSpeed(speed);
+		s = baseStep;
+	} else {
+		s = (uint16_t)((uint32_t)baseStep * speed / PLAY_SPEED_ONE);
+	}
+	cli();
+	step = s;	// 16-bit, read by Timer3 ISR
+	sei();
+	
+	if (speed == PLAY_SPEED_ONE)
+		PORTD &= 0b01111111;
+	else
+		PORTD |= 0b10000000;
+}
+
+// Returns the file page boundary being played: pages read from the file less pages still
+// in the buffer (the start of the page being played, or its end when playing backwards)
+int32_t dvr_position()
+{
+	int32_t buffered = (int32_t)buffer_pagesFull() * playPagesIn;
+	int32_t position;
+	
+	if (playReverse)
+		return (int32_t)pageCount + buffered;
+	
+	position = (int32_t)(playPages - pageCount) - buffered;
+	if ((loopState == 2) && (position < loopA))
+		position += loopB - loopA;	// Reader has wrapped, buffered pages are from the end of the loop
+	return position;
+}
+
+// Restarts playback from a file page boundary in the current direction (playback paused)
+// Restarting at the end of the file in the direction of play finishes playback
+// Any A-B loop is cleared
+void dvr_restart(int32_t target)
+{
+	if (loopState)
+		printf_P(PSTR("A-B: off\n"));
+	loopState = 0;
+	spliceMask = 0;
+	spliceCount = 0;
+	
+	if (target < 0)
+		target = 0;
+	if (target > playPages)
+		target = playPages;
+	
+	// Discard buffered samples and refill from the new position (cluster found through the link map)
+	wave_seek((uint32_t)target * BUFFER_PAGE_SIZE);
+	pageCount = playReverse ? (uint16_t)target : playPages - (uint16_t)target;
+	buffer_flush();
+	while (!pageCount && !playReverse && playlist_hasNext() && dvr_next());	// Past the end, on to the next file
+	if (!pageCount)
+		buffer_finish();
+	if (timeStretch)
+		stretch_reset();
+	if (playResample)
+		resample_reset();
+	adpcm_reset();
+	dvr_fill();
+	phase = 0;
+}
+
+// Moves playback forward/back by a number of seconds (whole pages, so ADPCM blocks stay aligned)
+// Seeking past the end finishes playback, seeking before the start restarts it (the other way 
+// round when playing backwards)
+void dvr_seek(int8_t seconds)
+{
+	TIMSK3 = 0x00;	// Pause playback (Timer3 CMPA interrupt)
+	dvr_restart(dvr_position() + (int32_t)seconds * (int32_t)playInfo.byteRate / BUFFER_PAGE_SIZE);
+	TIMSK3 = 0x02;	// Resume playback
+}
+
+// Reverses the direction of playback from the page being played
+// ADPCM blocks only decode forwards; files without a link map would re-walk the FAT chain 
+// from the first cluster for every page read backwards
+void dvr_reverse()
+{
+	int32_t position;
+	
+	if (playFormat == ADC_FORMAT_ADPCM) {
+		printf_P(PSTR("Reverse: not supported for ADPCM\n"));
+		return;
+	}
+	if (!wave_fastSeek()) {
+		printf_P(PSTR("Reverse: file too fragmented\n"));
+		return;
+	}
+	
+	TIMSK3 = 0x00;	// Pause playback (Timer3 CMPA interrupt)
+	position = dvr_position();
+	playReverse = !playReverse;
+	dvr_restart(position);
+	TIMSK3 = 0x02;	// Resume playback
+	printf_P(playReverse ? PSTR("Reverse: on\n") : PSTR("Reverse: off\n"));
+}
+
+// Steps the A-B loop (PB4 held): sets A at the start of the page being played, then B at its
+// end, looping from B back to A, then clears the loop
+// Each wrap seeks back to A through the cluster link map
+// When resampling, the loop spans whole buffer pages (playPagesIn file pages each) in step with
+// the reader, so it wraps at a buffer page boundary where the splice is ramped
+void dvr_loop()
+{
+	int32_t position;
+	
+	if (playReverse) {
+		printf_P(PSTR("A-B: not while reversed\n"));
+		return;
+	}
+	
+	position = dvr_position();
+	while (position < 0)
+		position += playPagesIn;	// First buffer page boundary of this file
+	
+	switch (loopState) {
+		case 0:
+			loopA = (uint16_t)position;
+			loopState = 1;
+			printf_P(PSTR("A-B: A at page %u\n"), loopA);
+			break;
+		case 1:
+			loopB = (uint16_t)position + playPagesIn;
+			if (loopB > loopA)
+				loopB = loopA + (loopB - loopA + playPagesIn - 1) / playPagesIn * playPagesIn;	// Whole buffer pages
+			if (loopB > playPages)
+				loopB = playPages;
+			if (loopB <= loopA) {
+				loopState = 0;	// B before A (seeked back)
+				printf_P(PSTR("A-B: off\n"));
+				break;
+			}
+			loopPass = 0;
+			loopState = 2;
+			if (playPages - pageCount >= loopB)
+				dvr_loopWrap(0);	// Pages after B already read, wrap at the next page
+			printf_P(PSTR("A-B: looping pages %u - %u\n"), loopA, loopB);
+			break;
+		default:
+			loopState = 0;
+			spliceMask = 0;
+			wave_seek((uint32_t)(playPages - pageCount) * BUFFER_PAGE_SIZE);	// Reader may have been served from the ring
+			printf_P(PSTR("A-B: off\n"));
+			break;
+	}
+}
+
+// Fills RAM from the end of .bss to the top of the stack with STACK_CANARY, at reset before the C runtime
+// is initialised (interrupts are off and nothing is on the stack; r1 is not yet zero, so in assembly)
+void stack_paint() __attribute__((naked, used, section(".init1")));
+void stack_paint()
+{
+	__asm__ __volatile__ (
+		"	ldi r30, lo8(__heap_start)\n"
+		"	ldi r31, hi8(__heap_start)\n"
+		"	ldi r24, %0\n"
+		"	ldi r25, hi8(__stack + 1)\n"
+		"1:	st Z+, r24\n"
+		"	cpi r30, lo8(__stack + 1)\n"
+		"	cpc r31, r25\n"
+		"	brlo 1b\n"
+		:: "M" (STACK_CANARY)
+	);
+}
+
+// Returns the bytes of stack never used since reset: the painted bytes above .bss left intact
+uint16_t stack_unused()
+{
+	extern uint8_t __heap_start;
+	const uint8_t* p = &__heap_start;
+	
+	while ((p <= (const uint8_t*)RAMEND) && (*p == STACK_CANARY))
+		p++;
+	return p - &__heap_start;
+}
+
+// Reports buffer overrun/underrun statistics for the last record/playback session, and the stack headroom
+// bits - Bits per sample, converts logged byte offsets to (approximate, for ADPCM) sample offsets
+void dvr_report(uint8_t bits)
+{
+	const BUFFER_STATS* stats = buffer_stats();
+	uint8_t i;
+	
+	printf_P(PSTR("Buffer overruns: %u (%lu samples dropped)\n"), stats->overruns, stats->samplesDropped);
+	for (i = 0; (i < stats->overruns) && (i < BUFFER_LOG_SIZE); i++)
+		printf_P(PSTR("  overrun at sample %lu\n"), stats->overrunOffset[i] * 8 / bits);
+	
+	printf_P(PSTR("Buffer underruns: %u (%lu samples held)\n"), stats->underruns, stats->samplesHeld);
+	for (i = 0; (i < stats->underruns) && (i < BUFFER_LOG_SIZE); i++)
+		printf_P(PSTR("  underrun at sample %lu\n"), stats->underrunOffset[i] * 8 / bits);
+	
+	printf_P(PSTR("Stack unused: %u bytes\n"), stack_unused());
+}
+
  void PwM_start()
  {
 
@@ -297,14 +943,30 @@ void dvr_play()
 	 DDRB |= 0b01000000;	   // JOUT - PORTB 6 as an output
 	 
 
-	 // Initialize Timer4 for 8-bit PWM
+	 // Initialize Timer4 for 8-bit PWM, or 10-bit PWM for 16-bit sources
 	 // Using OC4B, connected to B6 (JOUT)
-	 TCCR4B = 0b00000100; 
+	 // Carrier 64 MHz (PLL) / 256 = 250 kHz (62.5 kHz at 10-bit), well above the audio band (no interrupt)
+	 TCCR4B = 0b00000001;	// Prescaler /1
 	 TCCR4A = 0x21;   // bits 5 & 4 set clear on CMP, bit 0 enables PWM // TCCR4A FOR OCR4D
-	 OCR4C = TOP;    // set top to 0xFF (255)
-	 OCR4B = 128;   // initialize to DC duty cycle. Default DC = 50%. 
-	 TIMSK4 = 0x04;	// Timer/Counter4 Overflow Interrupt Enable
+	 if (playHiRes) {
+		 TC4H = DITHER_TOP10 >> 8;	// 10-bit registers: high bits through TC4H, written before the low byte
+		 OCR4C = DITHER_TOP10 & 0xFF;	// set top to 0x3FF (1023)
+		 TC4H = 0x02;
+		 OCR4B = 0x00;	// initialize to DC duty cycle. Default DC = 50%.
+	 } else {
+		 TC4H = 0x00;
+		 OCR4C = TOP;    // set top to 0xFF (255)
+		 OCR4B = 128;   // initialize to DC duty cycle. Default DC = 50%. 
+	 }
+	 TIMSK4 = 0x00;	// No Timer/Counter4 interrupts
 	 TCNT4 = 0x00;  // reset timer
+	 
+	 // Initialize Timer3 to update the output at PLAY_UPDATE_HZ (CTC)
+	 TCCR3A = 0x00;
+	 TCCR3B = 0x09;	// CTC (OCR3A top), prescaler /1
+	 OCR3A = (F_CPU / PLAY_UPDATE_HZ) - 1;
+	 TCNT3 = 0;
+	 TIMSK3 = 0x02;	// Timer/Counter3 Compare Match A Interrupt Enable
 
 
 	 serial_init();	// Initialise USB serial interface (debug)
@@ -314,6 +976,9 @@ void dvr_play()
 
  void PwM_stop(){
       check = 1;
+	  	 TIMSK3 = 0x00;
+	     TCCR3B = 0x00;
+	  	 TC4H = 0x00;
 	  	 TCNT4 = 0x00;
 	     TCCR4A = 0x00;
     	 TIMSK4 = 0x00;
@@ -321,16 +986,99 @@ void dvr_play()
 
  }
 
-	ISR(TIMER4_OVF_vect) {
-	if (~TIFR4 & 0b00000100 )
-	    ticks++;
+// Reads the next sample from the buffer in the playback format, as unsigned 8-bit
+static inline uint8_t play_sample()
+{
+	uint8_t fidgit;
+	
+	if (playFormat == ADC_FORMAT_PCM16)
+		fidgit = (buffer_dequeueWord() >> 8) ^ 0x80;	// Signed 16-bit to unsigned 8-bit
+	else if (playFormat == ADC_FORMAT_ADPCM)
+		fidgit = ((uint16_t)adpcm_dequeue() >> 8) ^ 0x80;	// Decode ADPCM to unsigned 8-bit
+	else {
+		fidgit = buffer_dequeue();		//dequeue here
+		if (playFormat == ADC_FORMAT_ULAW)
+			fidgit = g711_expandULaw(fidgit);
+		else if (playFormat == ADC_FORMAT_ALAW)
+			fidgit = g711_expandALaw(fidgit);
+	}
+	
+	return fidgit;
+}
 
-		
-	if (ticks == number)		
+// Ramps out the step at an A-B loop splice: the first sample after the splice takes the value
+// of the last sample before it, moving linearly to the samples of the loop start
+static inline void play_splice()
+{
+	int32_t x;
+	
+	if (spliceCount > (1 << PLAY_SPLICE_SHIFT))
+		spliceOffset = (int32_t)playPrev - playCur;	// First sample after the splice
+	spliceCount--;
+	
+	x = playCur + ((spliceOffset * spliceCount) >> PLAY_SPLICE_SHIFT);
+	if (playWide)
+		playCur = (x > 32767) ? 32767 : ((x < -32768) ? -32768 : (int16_t)x);
+	else
+		playCur = (x > 255) ? 255 : ((x < 0) ? 0 : (int16_t)x);
+}
+
+// Reads the next sample of a wide source (PCM16, ADPCM, mu-law or A-law) from the buffer, as signed 16-bit
+static inline int16_t play_sample16()
+{
+	if (playFormat == ADC_FORMAT_ADPCM)
+		return adpcm_dequeue();
+	else if (playFormat == ADC_FORMAT_ULAW)
+		return g711_expandULaw16(buffer_dequeue());
+	else if (playFormat == ADC_FORMAT_ALAW)
+		return g711_expandALaw16(buffer_dequeue());
+	
+	return buffer_dequeueWord();
+}
+
+	ISR(TIMER3_COMPA_vect) {
+	uint16_t p = phase + step;
+	
+	// Read each sample the phase passes (up to 3 per update at 3x speed)
+	while (p >= PLAY_PHASE_ONE)		
 	{
-		uint8_t fidgit = buffer_dequeue();		//dequeue here
-		OCR4B = fidgit ;
-		ticks = 0;
+		playPrev = playCur;
+		if (playWide)
+			playCur = play_sample16();
+		else
+			playCur = timeStretch ? stretch_dequeue() : play_sample();
+		p -= PLAY_PHASE_ONE;
+		
+		if (spliceCount)
+			play_splice();
+		
+		// Last sample before an A-B loop splice read, ramp from it into the next samples
+		if (spliceMask) {
+			uint8_t bit = 1 << (buffer_pagesReleased() & 7);
+			if (spliceMask & bit) {
+				spliceMask &= ~bit;
+				spliceCount = (1 << PLAY_SPLICE_SHIFT) + 1;
+			}
+		}
+	}
+	phase = p;
+	
+	if (holdTicks < PLAY_HOLD_TICKS)
+		holdTicks++;
+	
+	// Output every update, interpolated between the last two samples at the phase fraction (7 bits)
+	if (playWide) {
+		// 16-bit interpolation (halved difference cannot overflow), requantised to 10 or 8 bits
+		int16_t x = playPrev + (int16_t)(((int32_t)((playCur >> 1) - (playPrev >> 1)) * (int16_t)(p >> 7)) >> 6);
+		if (playHiRes) {
+			uint16_t v = playDither ? dither_quantise10(x) : (((uint16_t)x ^ 0x8000) >> 6);
+			TC4H = v >> 8;
+			OCR4B = (uint8_t)v;
+		} else {
+			OCR4B = dither_quantise8(x);
+		}
+	} else {
+		OCR4B = playPrev + (uint8_t)(((int16_t)(playCur - playPrev) * (int16_t)(p >> 7)) >> 7);
 	}
 	
 	push_button2 = push_button1;
@@ -352,6 +1100,9 @@ int main(void)
 {
 		
 	uint8_t state = DVR_STOPPED;	// Start DVR in stopped state
+	uint8_t* page;					// Buffer page to transfer to/from the SD card
+	uint8_t writing = 0;			// Flag that indicates a page is being written to the SD card
+	uint8_t n;						// Number of buffer pages read from the SD card in one transfer
 	//uint16_t pageBreak = 0;
 	//uint8_t push_buttons = 0;
 	//uint8_t PB3_val = 0;
@@ -368,9 +1119,40 @@ int main(void)
 		{   
 			case DVR_STOPPED:
 				PORTD |= 0b01000000;
+				
+				// Select recording sample rate from serial console ('1' - '5')
+				if (serial_available())
+				{
+					char c = getchar();
+					if ((c >= '1') && (c < '1' + TIMER_RATE_COUNT))
+						dvr_setRate(c - '1', oversample);
+					else if (c == 'b')
+						dvr_nextFormat();
+					else if (c == 'o')
+						dvr_setRate(sampleRate, oversample ? 0 : ADC_OVERSAMPLE);
+					else if (c == 't')
+					{
+						timeStretch = !timeStretch;
+						printf_P(timeStretch ? PSTR("Time-stretch: on\n") : PSTR("Time-stretch: off\n"));
+					}
+					else if (c == 'd')
+					{
+						playDither = !playDither;
+						printf_P(playDither ? PSTR("Dither: on\n") : PSTR("Dither: off\n"));
+					}
+#ifdef RESAMPLE_BENCHMARK
+					else if (c == 'r')
+						resample_benchmark(samples, PLAY_UPDATE_HZ);	// Buffer is idle while stopped
+#endif
+#ifdef SD_BENCHMARK
+					else if (c == 'k')
+						sdbench_run(samples, sizeof(samples));	// Buffer is idle while stopped
+#endif
+				}
+
 				if (~PINF & 0b00010000) //S1-Initiate Playback
 				{
-			     	printf("Begin Playback...");	// Output status to console
+			     	printf_P(PSTR("Begin Playback..."));	// Output status to console
 			     	dvr_play(); //Initiate Playback 
 					state = DVR_PLAYING;  // Transition to "recording" state
 	                PORTD &= 0b10111111;
@@ -378,7 +1160,7 @@ int main(void)
                  
 				if (~PINF & 0b00100000) 
 				{
-			     	printf("Start Recording...");	// Output status to console
+			     	printf_P(PSTR("Start Recording..."));	// Output status to console
 					dvr_record();			// Initiate recording
 					state = DVR_RECORDING;  // Transition to "recording" state
 	                PORTD &= 0b10111111;
@@ -391,27 +1173,47 @@ int main(void)
 				 {
 				 	//pageBreak = 500 - pageCount;
 					//write_file(ret(),2);
-					pageCount = 1;	// Finish recording last page
-					
+					adc_stop();		// Stop sampling, partially filled page is discarded
+					stop = 1;		// Flag recording complete
 				 }
 			
-				// Write samples to SD card when buffer page is full
-				if (newPage) 
+				// Write samples to SD card while full buffer pages are queued
+				// (the SD card is polled so the loop keeps servicing buttons while it is busy)
+				if (writing)
+				{
+					if (!wave_poll())
+					{
+						buffer_releasePage();	// Page written, return page to the buffer
+						writing = 0;
+					}
+				}
+				else if (pageCount && (page = buffer_readPage())) 
 				{   countpage++;
-					newPage = 0;	// Acknowledge new page flag
-					wave_write(buffer_readPage(), 512);
+					wave_writeAsync(page);	// Start writing page
+					writing = 1;
+					
+					if (!(--pageCount)) 
+					{
+						// If the last page is being written
+						adc_stop();		// Stop recording (disable new ADC conversions)
+						stop = 1;		// Flag recording complete
+					}
 				} 
 				else if (stop) 
 				{
 					// Stop is flagged when the last page has been recorded
+					// All recorded pages have been written once the buffer is drained
 					stop = 0;							// Acknowledge stop flag
-					wave_write(buffer_readPage(), 512);	// Write final page
 					wave_close();						// Finalise WAVE file 
 					adc_stop();                         // Stop  ADC sampling
-					printf("completed recording\n");    // Print status to console
+					printf_P(PSTR("completed recording\n"));    // Print status to console
+					dvr_report(pgm_read_byte(&formatBits[recordFormat]));		// Print buffer statistics to console
+#ifdef ADC_PROFILE
+					printf_P(PSTR("ADC ISR max: %u cycles\n"), adc_maxCycles());
+#endif
 					PORTD &= 0b11011111;
 					while (~PINF & 0b00100000){
-						printf("Please release record button ........ \n");
+						printf_P(PSTR("Please release record button ........ \n"));
 						continue;}
 					state = DVR_STOPPED;				// Transition to stopped state6
 
@@ -421,26 +1223,68 @@ int main(void)
 
 			case DVR_PLAYING:
                 debounce(); 
-                if (newPage) 
+				if (PB1_edge)
+					dvr_seek(-PLAY_SEEK_SECONDS);	// S1 - Seek back
+				else if (PB2_edge)
+					dvr_seek(PLAY_SEEK_SECONDS);	// S2 - Seek forward
+				
+				// Fine speed control ('+'/'-' 1/16 x) and direction ('v') from serial console
+				if (serial_available())
 				{
-					newPage = 0;	// Acknowledge new page flag
-					wave_read(buffer_writePage(), 512);
-
+					char c = getchar();
+					if ((c == '+') || (c == '-'))
+					{
+						dvr_setSpeed((c == '+') ? playSpeed + 1 : playSpeed - 1);
+						printf_P(PSTR("Speed: %u/16x\n"), playSpeed);
+					}
+					else if (c == 'v')
+						dvr_reverse();	// Play backwards/forwards from here
+				}
+				
+                // Read samples from SD card while empty buffer pages are available
+                // (every contiguous empty page in one read, the card reads ahead between reads)
+                if (pageCount && (page = buffer_writePages(PLAY_BURST_PAGES, &n))) 
+				{
+					buffer_commitPages(dvr_read(page, n));	// Queue pages for playback
+					if (!pageCount)
+						buffer_finish();	// Last page queued
+				}
+				else if (timeStretch && stretch_process())
+				{
+					// Time-stretched a hop of samples into the output queue
+				}
+				else if (playNext && !buffer_pagesFull())
+				{
+					// Last page of the previous file played, restart the output for the next file's format
+					playNext = 0;
+					PwM_stop();
+					dvr_start();
 				}
-                else if (stop || (~PINF & 0b01000000)) 
+                else if ((!pageCount && !buffer_pagesFull()) || (~PINF & 0b01000000)) 
 				{
-					// Stop is flagged when the last page has been played
+					// Playback is complete when the last page has been played
 					stop = 0;							// Acknowledge stop flag
 					wave_close();						// Finalise WAVE file 
 					PwM_stop();                         // Stop  PWM
-					printf("completed recording\n");    // Print status to console
+					printf_P(PSTR("completed recording\n"));    // Print status to console
+					dvr_report(pgm_read_byte(&formatBits[playFormat]));		// Print buffer statistics to console
+#ifdef STRETCH_PROFILE
+					if (timeStretch && playInfo.sampleRate)
+						printf_P(PSTR("Time-stretch max: %lu cycles/page (real time: %lu)\n"), 
+							stretch_maxCycles(), STRETCH_PAGE_SAMPLES * (F_CPU / playInfo.sampleRate));
+#endif
+#ifdef DITHER_PROFILE
+					if (playWide && playDither)
+						printf_P(PSTR("Dither max: %u cycles/sample (update period: %lu)\n"), 
+							dither_maxCycles(), F_CPU / PLAY_UPDATE_HZ);
+#endif
 					PORTD &= 0b11101111;
 					PORTD &= 0b01111111;
 					state = DVR_STOPPED;				// Transition to stopped state
-					fast = 0;
-					number = 2;
 
 				}
+				else
+					sleep_mode();	// Buffer full, idle until the next interrupt (Timer3 output update)
 				
 //				if ((~PINF & 0b10000000) && (fast == 0))
 //					{fast = 1; number = 1; ticks = 0; PORTD |= 0b10000000; }
@@ -451,7 +1295,7 @@ int main(void)
 				break;
 			default:
 				// Invalid state, return to valid idle state (stopped)
-				printf("ERROR: State machine in main entered invalid state!\n");
+				printf_P(PSTR("ERROR: State machine in main entered invalid state!\n"));
 				state = DVR_STOPPED;
 			    PORTD |= 0b01000000;
 				break;
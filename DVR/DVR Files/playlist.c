@@ -0,0 +1,184 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * playlist.c - EGB240DVR Library, Playlist module
+ *
+ * Queues WAVE files for playback one after another, such as 
+ * announcements built from prompt fragments. The files are listed in 
+ * the playlist file (PLAYLIST_FILENAME) in the root directory of the
+ * SD card, one filename per line; blank lines and lines starting with
+ * '#' are skipped. 
+ *
+ * Only the current filename is held in memory. The playlist file is
+ * opened for each entry, read from the offset following the previous
+ * entry and closed again, so lists of any length cost no memory. It
+ * is read between WAVE files (after wave_close), with the file object
+ * lent by the WAVE module, and parsed a character at a time straight
+ * into the filename (no line buffer). Each read also scans ahead for
+ * a following entry, so that the playback loop knows before the 
+ * current file ends whether to open the next one in its place.
+ *
+ * Requires:
+ *   lib/fatfs - FatFs FAT file system library published by ChaN 
+ *               (mounted by wave_init)
+ *   wave - Lends the file object used to read the playlist file, and
+ *          names the recording played when there is no playlist.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified by: Sid 
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+/************************************************************************/
+/* INCLUDED LIBRARIES/HEADER FILES                                      */
+/************************************************************************/
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include <string.h>
+
+#include "lib/fatfs/ff.h"
+
+#include "wave.h"
+#include "playlist.h"
+
+/************************************************************************/
+/* GLOBAL VARIABLES                                                     */
+/************************************************************************/
+char playlistName[PLAYLIST_NAME_SIZE];	// Filename of the current file (empty past the end of the playlist)
+DWORD playlistOffset = 0;				// Offset in the playlist file of the line following the current file
+uint8_t playlistMore = 0;				// Flag that indicates another entry follows the current file
+
+/************************************************************************/
+/* PRIVATE/UTILLITY FUNCTIONS                                           */
+/************************************************************************/
+
+/**
+ * Function: playlist_load
+ * 
+ * Reads the filename of the next entry of the playlist file, from the
+ * line at playlistOffset, into playlistName, and whether another entry
+ * follows it into playlistMore. Leading whitespace is skipped and the
+ * name ends at the first whitespace character; longer names are 
+ * truncated (and fail to open). playlistName is left empty if there 
+ * are no more entries or the playlist file cannot be read. No WAVE
+ * file may be open (the file object is lent by the WAVE module).
+ */
+void playlist_load() {
+	FIL* pList = wave_spareFile();
+	char c;
+	UINT br;
+	uint8_t n = 0;
+	uint8_t skip = 0;	// Rest of the line is skipped (comment, or after the name)
+	
+	// The filename buffer holds the playlist filename while it is opened (no copy in RAM)
+	strcpy_P(playlistName, PSTR(PLAYLIST_FILENAME));
+	playlistMore = 0;
+	if (f_open(pList, playlistName, FA_READ)) {
+		playlistName[0] = '\0';
+		return;
+	}
+	
+	if (!f_lseek(pList, playlistOffset)) {
+		// Characters are read one at a time from the file system sector buffer
+		while (!f_read(pList, &c, 1, &br) && br) {
+			if (c == '\n') {
+				if (n)
+					break;	// End of the line holding the name
+				skip = 0;
+			} else if (skip) {
+				continue;
+			} else if (c > ' ') {
+				if (!n && (c == '#'))
+					skip = 1;	// Comment
+				else if (n < PLAYLIST_NAME_SIZE - 1)
+					playlistName[n++] = c;
+			} else if (n) {
+				skip = 1;	// Whitespace ends the name
+			}
+		}
+		playlistOffset = f_tell(pList);
+		
+		// Scan ahead for the first character of a following name
+		skip = 0;
+		while (n && !f_read(pList, &c, 1, &br) && br) {
+			if (c == '\n') {
+				skip = 0;
+			} else if (!skip && (c > ' ')) {
+				if (c != '#') {
+					playlistMore = 1;
+					break;
+				}
+				skip = 1;	// Comment
+			}
+		}
+	}
+	playlistName[n] = '\0';
+	
+	f_close(pList);
+}
+
+/************************************************************************/
+/* PUBLIC/USER FUNCTIONS                                                */
+/************************************************************************/
+
+/**
+ * Function: playlist_start
+ * 
+ * Loads the first file listed in the playlist file, or the recording 
+ * (WAVE_FILENAME) if there is no playlist file or it lists no files.
+ * No WAVE file may be open.
+ */
+void playlist_start() {
+	playlistOffset = 0;
+	playlist_load();
+	if (!playlistName[0])
+		strcpy_P(playlistName, PSTR(WAVE_FILENAME));
+}
+
+/**
+ * Function: playlist_name
+ * 
+ * Returns: The filename of the current file, valid until playlist_start
+ *          or playlist_advance is next called (empty past the end of 
+ *          the playlist).
+ */
+const char* playlist_name() {
+	return playlistName;
+}
+
+/**
+ * Function: playlist_hasNext
+ * 
+ * Returns: True if another file of the playlist follows the current one.
+ */
+uint8_t playlist_hasNext() {
+	return playlistMore;
+}
+
+/**
+ * Function: playlist_advance
+ * 
+ * Moves to the file following the current one, reading its filename 
+ * from the playlist file. No WAVE file may be open. Has no effect at 
+ * the end of the playlist.
+ */
+void playlist_advance() {
+	if (playlistMore)
+		playlist_load();
+}
\ No newline at end of file
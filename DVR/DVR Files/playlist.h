@@ -0,0 +1,40 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * playlist.h - EGB240DVR Library, Playlist module header
+ *
+ * Queues WAVE files for back to back playback from a playlist file in
+ * the root directory of the SD card, one 8.3 filename per line.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified By: Sid
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+#ifndef PLAYLIST_H_
+#define PLAYLIST_H_
+
+#define PLAYLIST_FILENAME	"PLAYLIST.TXT"	// Playlist file, played in place of the recording when present
+#define PLAYLIST_NAME_SIZE	13		// Longest filename (8.3, as PLAYLIST_FILENAME) plus terminator
+
+void playlist_start();				// Loads the first file listed in the playlist file (the recording if there is none)
+const char* playlist_name();		// Filename of the current file
+uint8_t playlist_hasNext();			// True if another file follows the current one
+void playlist_advance();			// Moves to the following file of the playlist (no WAVE file may be open)
+
+#endif /* PLAYLIST_H_ */
\ No newline at end of file
@@ -0,0 +1,294 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+/**
+ * resample.c - EGB240DVR Library, Resampler module
+ *
+ * Prepares PCM files authored off-device for playback. The playback 
+ * ISR steps through samples at any rate up to its update rate with a
+ * fractional phase accumulator, which is exact in rate but cannot 
+ * decimate without aliasing, and reads a single channel. This stage
+ * runs in the main loop between wave_read and the circular buffer, a
+ * page of file data at a time, and converts each frame to a signed 
+ * 16-bit mono sample:
+ *
+ *   - Stereo is downmixed ((L + R) / 2) as each frame is read.
+ *   - Rates above the update rate (44.1 and 48 kHz) are decimated by
+ *     two with a 19-tap half-band FIR in polyphase form: one phase is
+ *     the centre tap alone (0.5) and the other a symmetric 10-tap 
+ *     filter, so each output costs five 16x16 multiplies on pre-added 
+ *     sample pairs. Coefficients are Q15 (Blackman windowed sinc), 
+ *     flat to 0.15 fs, -6 dB at the output Nyquist frequency and below
+ *     -45 dB from 0.35 fs.
+ *
+ * The ISR then interpolates the 8 - 24 kHz output to its update rate,
+ * so every standard rate plays at the correct pitch and speed. Input 
+ * history is kept in a small ring indexed by a wrapping 8-bit count,
+ * so pages (and frames) may be split anywhere. The ring lives in a 
+ * work area supplied by the caller (RESAMPLE_WORK_SIZE bytes, spare 
+ * buffer space while resampling) rather than in static memory.
+ *
+ * Define RESAMPLE_BENCHMARK to time the stage for each standard rate
+ * and channel count on the target (resample_benchmark) with Timer1.
+ * Each line gives the measured cycles per output sample against the
+ * cycles available per output sample at that rate; the difference is
+ * the headroom left for the playback ISR and SD card reads. No board
+ * figures have been taken yet: estimated by hand from the source, a 
+ * decimated stereo 16-bit output costs roughly 300 cycles (five 
+ * multiply-accumulates, ten pre-adds and two frame reads) against 725
+ * available at 22.05 kHz; the benchmark supersedes this estimate.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified by: Sid 
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+/************************************************************************/
+/* INCLUDED LIBRARIES/HEADER FILES                                      */
+/************************************************************************/
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+
+#include "resample.h"
+
+/************************************************************************/
+/* MACROS                                                               */
+/************************************************************************/
+#define HISTORY_MASK	(RESAMPLE_HISTORY - 1)
+
+// Half-band side taps (Q15, doubled to apply to halved sample pairs) at 
+// offsets +/-1, 3, 5, 7 and 9 from the centre; the centre tap is 0.5
+#define HALFBAND_1		20172
+#define HALFBAND_3		-5118
+#define HALFBAND_5		1730
+#define HALFBAND_7		-476
+#define HALFBAND_9		76
+
+/************************************************************************/
+/* GLOBAL VARIABLES                                                     */
+/************************************************************************/
+int16_t* resampleHistory;		// Mono input history (ring in the work area)
+uint8_t resampleIndex;			// Count of input samples (next history slot)
+uint8_t resampleChannels = 1;	// Input channels (1 or 2)
+uint8_t resampleBits = 16;		// Input bits per sample (8 or 16)
+uint8_t resampleFactor = 1;		// Decimation factor (1 or 2)
+
+#ifdef RESAMPLE_BENCHMARK
+// Standard sample rates benchmarked
+static const uint16_t benchRates[] PROGMEM = {
+	8000, 11025, 16000, 22050, 44100, 48000
+};
+#endif
+
+/************************************************************************/
+/* PRIVATE/UTILLITY FUNCTIONS                                           */
+/************************************************************************/
+
+/**
+ * Function: pair
+ * 
+ * Utility function. Halved sum of two history samples (cannot overflow).
+ *
+ * Parameters:
+ *    a, b - History indices (masked here)
+ *
+ * Returns: (history[a] + history[b]) / 2
+ */
+static inline int16_t pair(uint8_t a, uint8_t b) {
+	return (resampleHistory[a & HISTORY_MASK] >> 1) + (resampleHistory[b & HISTORY_MASK] >> 1);
+}
+
+/**
+ * Function: decimate
+ * 
+ * Utility function. Half-band filter output centred RESAMPLE_TAPS / 2
+ * samples behind the newest input sample.
+ *
+ * Returns: Filtered sample (signed 16-bit, clipped)
+ */
+static int16_t decimate() {
+	uint8_t n = resampleIndex - 1;	// Newest sample
+	int32_t acc = (int32_t)resampleHistory[(uint8_t)(n - 9) & HISTORY_MASK] << 14;
+	
+	acc += (int32_t)HALFBAND_1 * pair(n - 8, n - 10);
+	acc += (int32_t)HALFBAND_3 * pair(n - 6, n - 12);
+	acc += (int32_t)HALFBAND_5 * pair(n - 4, n - 14);
+	acc += (int32_t)HALFBAND_7 * pair(n - 2, n - 16);
+	acc += (int32_t)HALFBAND_9 * pair(n, n - 18);
+	acc >>= 15;
+	
+	if (acc > 32767)
+		return 32767;
+	else if (acc < -32768)
+		return -32768;
+	return (int16_t)acc;
+}
+
+/**
+ * Function: read_frame
+ * 
+ * Utility function. Reads a frame of input as a mono sample.
+ *
+ * Parameters:
+ *    pIn - Frame (unsigned 8-bit or signed 16-bit samples, interleaved)
+ *
+ * Returns: Signed 16-bit sample
+ */
+static inline int16_t read_frame(uint8_t* pIn) {
+	if (resampleBits == 8) {
+		int16_t s = (int16_t)pIn[0] - 0x80;
+		if (resampleChannels == 2)
+			s = (s + ((int16_t)pIn[1] - 0x80)) >> 1;
+		return s << 8;
+	} else {
+		int16_t s = *(int16_t*)pIn;
+		if (resampleChannels == 2)
+			s = (s >> 1) + (*(int16_t*)(pIn + 2) >> 1);
+		return s;
+	}
+}
+
+/************************************************************************/
+/* PUBLIC/USER FUNCTIONS                                                */
+/************************************************************************/
+
+/**
+ * Function: resample_init
+ * 
+ * Sets the work area, input format and decimation factor, and clears 
+ * the history.
+ *
+ * Parameters:
+ *    pWork - Work area (RESAMPLE_WORK_SIZE bytes, 2-byte aligned), used
+ *            until the next call
+ *    channels - Input channels (1 or 2)
+ *    bits - Input bits per sample (8 or 16, PCM)
+ *    factor - Decimation factor (1, downmix only, or 2)
+ */
+void resample_init(uint8_t* pWork, uint8_t channels, uint8_t bits, uint8_t factor) {
+	resampleHistory = (int16_t*)pWork;
+	resampleChannels = channels;
+	resampleBits = bits;
+	resampleFactor = factor;
+	
+	resample_reset();
+}
+
+/**
+ * Function: resample_reset
+ * 
+ * Clears the filter history. Called when the input is discontinuous 
+ * (e.g. after a seek) so no samples of the old position are output.
+ */
+void resample_reset() {
+	uint8_t i;
+	
+	for (i = 0; i < RESAMPLE_HISTORY; i++)
+		resampleHistory[i] = 0;
+	resampleIndex = 0;
+}
+
+/**
+ * Function: resample_process
+ * 
+ * Converts input frames to signed 16-bit mono output samples. With a
+ * decimation factor of two, an output is produced for every second 
+ * input frame.
+ *
+ * Parameters:
+ *    pIn - Input frames
+ *    count - Input size (bytes, whole frames)
+ *    pOut - Output samples
+ *
+ * Returns: Number of bytes of output written
+ */
+uint16_t resample_process(uint8_t* pIn, uint16_t count, uint8_t* pOut) {
+	uint8_t frame = resampleChannels * (resampleBits >> 3);
+	uint8_t* pEnd = pIn + count;
+	int16_t* pSample = (int16_t*)pOut;
+	int16_t s;
+	
+	for (; pIn < pEnd; pIn += frame) {
+		s = read_frame(pIn);
+		
+		if (resampleFactor == 1) {
+			*pSample++ = s;
+		} else {
+			resampleHistory[resampleIndex & HISTORY_MASK] = s;
+			if (++resampleIndex & 1)
+				continue;
+			*pSample++ = decimate();	// Every second input (polyphase: only outputs are computed)
+		}
+	}
+	
+	return (uint8_t*)pSample - pOut;
+}
+
+#ifdef RESAMPLE_BENCHMARK
+/**
+ * Function: resample_benchmark
+ * 
+ * Times the conversion of a page of (pseudo-random) input for each 
+ * standard rate with one and two channels of 8 and 16-bit PCM, and
+ * prints the cycles per output sample against the cycles available per
+ * output sample. Mono files at or below the output rate are not 
+ * resampled and are skipped. The work area is overwritten.
+ *
+ * Parameters:
+ *    pWork - Work area (1024 + RESAMPLE_WORK_SIZE bytes: a page of input,
+ *            a page of output and the filter history)
+ *    rateMax - Highest rate played without decimation (output update rate)
+ */
+void resample_benchmark(uint8_t* pWork, uint16_t rateMax) {
+	uint8_t tccr1b = TCCR1B;
+	uint16_t i, rate, bytes, ticks;
+	uint8_t r, channels, bits, factor;
+	
+	for (i = 0; i < 512; i++)
+		pWork[i] = (uint8_t)(i * 97 + (i >> 3));	// Input: any full range data
+	
+	TCCR1A = 0x00;	// Normal mode
+	TCCR1B = 0x02;	// Timer1, /8 prescaler (a page fits in 16 bits)
+	
+	printf_P(PSTR("Resample benchmark (cycles per output sample / available):\n"));
+	for (r = 0; r < sizeof(benchRates) / sizeof(benchRates[0]); r++) {
+		rate = pgm_read_word(&benchRates[r]);
+		factor = (rate > rateMax) ? 2 : 1;
+		
+		for (channels = 1; channels <= 2; channels++) {
+			if ((channels == 1) && (factor == 1))
+				continue;	// Played directly
+			
+			for (bits = 8; bits <= 16; bits += 8) {
+				resample_init(pWork + 1024, channels, bits, factor);
+				TCNT1 = 0;
+				bytes = resample_process(pWork, 512, pWork + 512);
+				ticks = TCNT1;
+				
+				printf_P(PSTR("  %u Hz, %u ch, %u-bit: %lu / %lu\n"), rate, channels, bits, 
+					(uint32_t)ticks * 8 * 2 / bytes, F_CPU * factor / rate);
+			}
+		}
+	}
+	
+	TCCR1B = tccr1b;	// Restore Timer1 (ADC/stretch profiling)
+}
+#endif
\ No newline at end of file
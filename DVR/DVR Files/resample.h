@@ -0,0 +1,47 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+/**
+ * resample.h - EGB240DVR Library, Resampler module header
+ *
+ * Converts PCM sample frames read from a WAVE file to signed 16-bit mono
+ * at a rate the playback output can step through: stereo is downmixed
+ * and rates above the output update rate are decimated by two.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified By: Sid
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+#ifndef RESAMPLE_H_
+#define RESAMPLE_H_
+
+#define RESAMPLE_TAPS		19		// Length of the half-band decimation filter
+#define RESAMPLE_HISTORY	32		// Input history (mono samples, a power of two of at least RESAMPLE_TAPS)
+#define RESAMPLE_WORK_SIZE	(RESAMPLE_HISTORY * 2)	// Size of the work area (input history)
+
+void resample_init(uint8_t* pWork, uint8_t channels, uint8_t bits, uint8_t factor);	// Sets the work area, input format (1-2 channels, 8/16-bit PCM) and decimation factor (1 or 2)
+void resample_reset();				// Clears the filter history (e.g. after a seek)
+uint16_t resample_process(uint8_t* pIn, uint16_t count, uint8_t* pOut);	// Converts count bytes of input frames, returns bytes of output written
+
+#ifdef RESAMPLE_BENCHMARK
+void resample_benchmark(uint8_t* pWork, uint16_t rateMax);	// Prints cycles per output sample for standard rates (1024 + RESAMPLE_WORK_SIZE byte work area)
+#endif
+
+#endif /* RESAMPLE_H_ */
\ No newline at end of file
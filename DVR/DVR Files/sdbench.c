@@ -0,0 +1,158 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+
+/**
+ * sdbench.c - EGB240DVR Library, SD card throughput benchmark
+ *
+ * Writes and reads a contiguous file (BENCH.BIN) directly through the
+ * disk I/O layer and prints the throughput of each SD card command:
+ *
+ *   CMD24 - WRITE_BLOCK, one sector per disk_write call
+ *   CMD25 - WRITE_MULTIPLE_BLOCK, a full buffer per disk_write call
+ *   CMD17 - READ_SINGLE_BLOCK, one sector per disk_read call
+ *   CMD18 - READ_MULTIPLE_BLOCK, a full buffer per disk_read call
+ *
+ * Each test is run with polled and cycle-counted SPI block transfers
+ * (MMC_SET_UNROLLED) so the two loops can be compared on the same card.
+ * The file is deleted when the benchmark completes.
+ *
+ * Requires:
+ *   lib/fatfs - FatFs FAT file system library published by ChaN
+ *   wave - The SD card must be mounted (wave_init)
+ *   serial - USB serial interface to print results
+ *
+ * Hardware resources:
+ *   Timer1 is used to time each test (/1024 prescaler, 64 us ticks).
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified by: Sid 
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+#ifdef SD_BENCHMARK
+
+/************************************************************************/
+/* INCLUDED LIBRARIES/HEADER FILES                                      */
+/************************************************************************/
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include <stdio.h>
+
+#include "lib/fatfs/ff.h"
+#include "lib/fatfs/diskio.h"
+
+#include "sdbench.h"
+
+// FatFs hidden API: first sector of a cluster
+DWORD clust2sect(FATFS* fs, DWORD clst);
+
+/************************************************************************/
+/* PRIVATE/UTILLITY FUNCTIONS                                           */
+/************************************************************************/
+
+/**
+ * Function: sdbench_report
+ * 
+ * Prints the throughput of a test to the serial console.
+ *
+ * Parameters:
+ *   pName - Test name (program memory)
+ *   ticks - Test duration (Timer1 ticks, 64 us)
+ * 
+ * Returns: void
+ */
+static void sdbench_report(const char* pName, uint16_t ticks) {
+	// KB/s = bytes / (ticks * 64 us) / 1024
+	uint32_t rate = ticks ? ((uint32_t)SDBENCH_SECTORS * 512 * 15625 / 1024) / ticks : 0;
+	printf_P(PSTR("  %S: %lu KB/s\n"), pName, rate);
+}
+
+/************************************************************************/
+/* PUBLIC/USER FUNCTIONS                                                */
+/************************************************************************/
+
+/**
+ * Function: sdbench_run
+ * 
+ * Creates a contiguous benchmark file, times single and multiple block
+ * writes and reads of the whole file with each SPI transfer loop and
+ * prints the results. The buffer contents are overwritten.
+ *
+ * Parameters:
+ *   pBuffer - Buffer to transfer to/from the SD card
+ *   size - Size of buffer (bytes, a multiple of 512)
+ * 
+ * Returns: void
+ */
+void sdbench_run(uint8_t* pBuffer, uint16_t size) {
+	FIL bench;
+	DWORD sector, n;
+	UINT count = size / 512;
+	BYTE mode;
+	uint16_t ticks;
+	uint8_t tccr1b = TCCR1B;
+	
+	if (f_open(&bench, "BENCH.BIN", FA_CREATE_ALWAYS | FA_WRITE) || f_expand(&bench, (DWORD)SDBENCH_SECTORS * 512)) {
+		printf_P(PSTR("Unable to create benchmark file\n"));
+		return;
+	}
+	sector = clust2sect(bench.fs, bench.sclust);
+	
+	TCCR1B = 0x05;	// Timer1, /1024 prescaler (64 us per tick)
+	
+	for (mode = 0; mode < 2; mode++) {
+		disk_ioctl(0, MMC_SET_UNROLLED, &mode);
+		printf_P(mode ? PSTR("SD benchmark, cycle-counted SPI:\n") : PSTR("SD benchmark, polled SPI:\n"));
+		
+		TCNT1 = 0;
+		for (n = 0; n < SDBENCH_SECTORS; n++)
+			disk_write(0, pBuffer, sector + n, 1);
+		disk_ioctl(0, CTRL_SYNC, 0);
+		ticks = TCNT1;
+		sdbench_report(PSTR("CMD24"), ticks);
+		
+		TCNT1 = 0;
+		for (n = 0; n < SDBENCH_SECTORS; n += count)
+			disk_write(0, pBuffer, sector + n, (SDBENCH_SECTORS - n < count) ? SDBENCH_SECTORS - n : count);
+		disk_ioctl(0, CTRL_SYNC, 0);
+		ticks = TCNT1;
+		sdbench_report(PSTR("CMD25"), ticks);
+		
+		TCNT1 = 0;
+		for (n = 0; n < SDBENCH_SECTORS; n++)
+			disk_read(0, pBuffer, sector + n, 1);
+		ticks = TCNT1;
+		sdbench_report(PSTR("CMD17"), ticks);
+		
+		TCNT1 = 0;
+		for (n = 0; n < SDBENCH_SECTORS; n += count)
+			disk_read(0, pBuffer, sector + n, (SDBENCH_SECTORS - n < count) ? SDBENCH_SECTORS - n : count);
+		ticks = TCNT1;
+		sdbench_report(PSTR("CMD18"), ticks);
+	}
+	
+	TCCR1B = tccr1b;	// Restore Timer1 (ADC profiling)
+	
+	f_close(&bench);
+	f_unlink("BENCH.BIN");
+}
+
+#endif /* SD_BENCHMARK */
\ No newline at end of file
@@ -0,0 +1,40 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+/**
+ * sdbench.h - EGB240DVR Library, SD card throughput benchmark header
+ *
+ * Measures SD card read/write throughput (KB/s) for single and
+ * multiple block commands. Compiled only with SD_BENCHMARK defined.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified By: Sid
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+#ifndef SDBENCH_H_
+#define SDBENCH_H_
+
+#define SDBENCH_SECTORS		64		// Size of the benchmark file (sectors)
+
+#ifdef SD_BENCHMARK
+void sdbench_run(uint8_t* pBuffer, uint16_t size);	// Runs the benchmark using a buffer of size bytes (multiple of 512)
+#endif
+
+#endif /* SDBENCH_H_ */
\ No newline at end of file
@@ -0,0 +1,289 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+
+/**
+ * stretch.c - EGB240DVR Library, Time-stretch (WSOLA) module
+ *
+ * Plays recordings faster (1x - 2x) at their natural pitch using
+ * waveform similarity overlap-add (WSOLA). The stage runs in the main
+ * loop between the circular buffer and the playback ISR: it pulls 
+ * decoded samples from a source function into an input history and 
+ * pushes output samples into a small queue read by the ISR at 1x.
+ *
+ * Each hop outputs STRETCH_HOP samples. The nominal input position
+ * advances by STRETCH_HOP * speed per hop; about it, candidate
+ * segments within +/- STRETCH_SEARCH samples are scored by a fixed-
+ * point cross-correlation (every second sample and position) against
+ * the natural continuation of the previous segment. The hop is a 
+ * linear crossfade from that continuation into the best candidate,
+ * so waveform periods line up and no pitch change is heard.
+ *
+ * The input history and output queue are 256 samples each, indexed 
+ * by 8-bit indices that wrap without masking. Both live in a work 
+ * area supplied by the application (a spare buffer page). The output
+ * queue is single-producer/single-consumer; stretch_dequeue may be
+ * called from an ISR without masking interrupts.
+ *
+ * Define STRETCH_PROFILE to measure the cycles taken to produce each
+ * page (STRETCH_PAGE_SAMPLES) of output with Timer1 (stretch_maxCycles).
+ * Time spent in interrupts during a hop is included. Each hop of 64 
+ * output samples takes 33 candidates x 32 products (1056 8 x 8-bit
+ * multiply-accumulates) and 64 crossfade products. The cycle cost has
+ * not been measured on the target yet: compare stretch_maxCycles with 
+ * the budget printed for the file's rate before relying on 2x.
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified by: Sid 
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+/************************************************************************/
+/* INCLUDED LIBRARIES/HEADER FILES                                      */
+/************************************************************************/
+#include <avr/io.h>
+
+#include "stretch.h"
+
+/************************************************************************/
+/* MACROS                                                               */
+/************************************************************************/
+
+// Compiler memory barrier: output samples are stored before the queue head is published
+#define STRETCH_BARRIER()	__asm__ __volatile__ ("" ::: "memory")
+
+/************************************************************************/
+/* GLOBAL VARIABLES                                                     */
+/************************************************************************/
+uint8_t* pHistory;			// Input history (256 samples, indexed by the low byte of the input position)
+uint8_t* pOutput;			// Output queue (256 samples)
+uint8_t (*source)();		// Input sample source (unsigned 8-bit)
+
+uint16_t inHead;			// Input position of the next sample read from the source
+uint16_t segment;			// Input position of the segment chosen for the last hop
+uint16_t target;			// Nominal input position of the next hop
+uint8_t hopIn = STRETCH_HOP;	// Input samples advanced per hop at the selected speed
+
+volatile uint8_t outHead;	// Output queue write index (owned by stretch_process)
+volatile uint8_t outTail;	// Output queue read index (owned by stretch_dequeue)
+uint8_t lastSample;			// Last sample returned by stretch_dequeue
+
+#ifdef STRETCH_PROFILE
+uint32_t pageCycles;		// Cycles spent producing the current page of output
+uint16_t pageSamples;		// Output samples produced in the current page
+uint32_t maxPageCycles;		// Longest measured page (CPU cycles)
+#endif
+
+/************************************************************************/
+/* PRIVATE/UTILLITY FUNCTIONS                                           */
+/************************************************************************/
+
+/**
+ * Function: correlate
+ * 
+ * Utility function. Fixed-point cross-correlation of two segments of
+ * the input history over one hop, using every second sample. Products
+ * are scaled so the sum cannot overflow 16 bits.
+ *
+ * Parameters:
+ *    a - Input position of the first segment
+ *    b - Input position of the second segment
+ *
+ * Returns: Correlation score (larger is more similar)
+ */
+static int16_t correlate(uint8_t a, uint8_t b) {
+	int16_t sum = 0;
+	uint8_t i;
+	
+	for (i = 0; i < STRETCH_HOP; i += 2) {
+		int8_t x = pHistory[a] ^ 0x80;	// Unsigned to signed
+		int8_t y = pHistory[b] ^ 0x80;
+		sum += ((int16_t)x * y) >> 5;
+		a += 2;
+		b += 2;
+	}
+	
+	return sum;
+}
+
+/************************************************************************/
+/* PUBLIC/USER FUNCTIONS                                                */
+/************************************************************************/
+
+/**
+ * Function: stretch_init
+ * 
+ * Initialises the time-stretch stage for a playback session.
+ *
+ * Parameters:
+ *    pWork - Work area of STRETCH_WORK_SIZE bytes
+ *    pSource - Function returning the next input sample (unsigned 8-bit)
+ */
+void stretch_init(uint8_t* pWork, uint8_t (*pSource)()) {
+	pHistory = pWork;
+	pOutput = pWork + (STRETCH_WORK_SIZE / 2);
+	source = pSource;
+	
+#ifdef STRETCH_PROFILE
+	TCCR1A = 0x00;	// Normal mode
+	TCCR1B = 0x01;	// Start Timer1, /1 prescaler (counts CPU cycles)
+	maxPageCycles = 0;
+#endif
+	
+	stretch_reset();
+}
+
+/**
+ * Function: stretch_reset
+ * 
+ * Discards the input history and any queued output. The next hop
+ * starts at the next sample from the source. Must not be called while
+ * an ISR is reading the output queue.
+ */
+void stretch_reset() {
+	inHead = 0;
+	segment = -STRETCH_HOP;		// Continuation of the "previous" segment is the first input sample
+	target = STRETCH_SEARCH;	// Lowest candidate is the first input sample
+	
+	outHead = 0;
+	outTail = 0;
+	lastSample = 0x80;	// Mid-scale (silence)
+	
+#ifdef STRETCH_PROFILE
+	pageCycles = 0;
+	pageSamples = 0;
+#endif
+}
+
+/**
+ * Function: stretch_setSpeed
+ * 
+ * Sets the speed of the time-stretch (input samples consumed per
+ * output sample). Takes effect on the next hop.
+ *
+ * Parameters:
+ *    speed - Speed in 1/16 steps (STRETCH_SPEED_MIN - STRETCH_SPEED_MAX)
+ */
+void stretch_setSpeed(uint8_t speed) {
+	if (speed < STRETCH_SPEED_MIN)
+		speed = STRETCH_SPEED_MIN;
+	if (speed > STRETCH_SPEED_MAX)
+		speed = STRETCH_SPEED_MAX;
+	
+	hopIn = (uint16_t)STRETCH_HOP * speed / 16;
+}
+
+/**
+ * Function: stretch_process
+ * 
+ * Produces one hop of output if the output queue has room for it.
+ * Reads input from the source as far as the furthest candidate 
+ * segment, searches for the best matching segment and crossfades 
+ * into it. Called repeatedly from the main loop.
+ *
+ * Returns: True if a hop was produced, false if the queue is full
+ */
+uint8_t stretch_process() {
+	uint16_t cand, best;
+	int16_t score, bestScore;
+	uint8_t i, a, b, o;
+	
+	// Room for a hop in the output queue
+	if ((uint8_t)(outHead - outTail) > (uint8_t)(255 - STRETCH_HOP))
+		return 0;
+	
+#ifdef STRETCH_PROFILE
+	uint16_t start = TCNT1;
+#endif
+	
+	// Read input up to the end of the furthest candidate
+	while ((int16_t)(target + STRETCH_SEARCH + STRETCH_HOP - inHead) > 0)
+		pHistory[(uint8_t)inHead++] = source();
+	
+	// Search about the nominal position for the segment most similar to the continuation of the last segment
+	best = target;
+	bestScore = INT16_MIN;
+	for (cand = target - STRETCH_SEARCH; cand != target + STRETCH_SEARCH + 2; cand += 2) {
+		score = correlate(segment + STRETCH_HOP, cand);
+		if (score > bestScore) {
+			bestScore = score;
+			best = cand;
+		}
+	}
+	
+	// Crossfade from the continuation of the last segment into the chosen segment
+	a = segment + STRETCH_HOP;
+	b = best;
+	o = outHead;
+	for (i = 0; i < STRETCH_HOP; i++)
+		pOutput[o++] = (pHistory[a++] * (uint16_t)(STRETCH_HOP - i) + pHistory[b++] * (uint16_t)i) / STRETCH_HOP;
+	
+	STRETCH_BARRIER();
+	outHead = o;	// Publish hop to ISR
+	
+	segment = best;
+	target += hopIn;
+	
+#ifdef STRETCH_PROFILE
+	pageCycles += (uint16_t)(TCNT1 - start);
+	pageSamples += STRETCH_HOP;
+	if (pageSamples >= STRETCH_PAGE_SAMPLES) {
+		if (pageCycles > maxPageCycles)
+			maxPageCycles = pageCycles;
+		pageCycles = 0;
+		pageSamples = 0;
+	}
+#endif
+	
+	return 1;
+}
+
+/**
+ * Function: stretch_dequeue
+ * 
+ * Removes and returns a sample from the output queue. If the queue is
+ * empty (the stage has fallen behind) the last sample is repeated.
+ *
+ * Returns: Output sample (unsigned 8-bit)
+ */
+uint8_t stretch_dequeue() {
+	uint8_t t = outTail;
+	
+	if (t == outHead)
+		return lastSample;
+	
+	lastSample = pOutput[t++];
+	outTail = t;
+	
+	return lastSample;
+}
+
+#ifdef STRETCH_PROFILE
+/**
+ * Function: stretch_maxCycles
+ * 
+ * Returns: The longest time to produce a page of output (STRETCH_PAGE_SAMPLES)
+ *          measured since the last call (CPU cycles).
+ */
+uint32_t stretch_maxCycles() {
+	uint32_t cycles = maxPageCycles;
+	maxPageCycles = 0;
+	return cycles;
+}
+#endif
\ No newline at end of file
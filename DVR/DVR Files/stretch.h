@@ -0,0 +1,52 @@
+/*Copyright [2017] [Siddhant Mahapatra]
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	https://github.com/Robosid/Electronics/blob/master/License.pdf
+    https://github.com/Robosid/Electronics/blob/master/License.rtf
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+
+/**
+ * stretch.h - EGB240DVR Library, Time-stretch (WSOLA) module header
+ *
+ * Speeds up playback without raising the pitch by overlap-adding
+ * waveform-similar segments of the input (WSOLA).
+ *
+ * Version: v1.0
+ *    Date: 05/29/2017
+ *  Modified By: Sid
+ *  E-mail: robo_sid@yahoo.co.uk
+ */ 
+
+#ifndef STRETCH_H_
+#define STRETCH_H_
+
+#define STRETCH_HOP			64		// Output samples per hop (also the crossfade length)
+#define STRETCH_SEARCH		32		// Search range (+/- input samples) about the nominal position
+#define STRETCH_WORK_SIZE	512		// Size of the work area (input history and output queue, 256 bytes each)
+
+#define STRETCH_SPEED_MIN	16		// Slowest speed (1x, in 1/16 steps)
+#define STRETCH_SPEED_MAX	32		// Fastest speed (2x, in 1/16 steps)
+
+void stretch_init(uint8_t* pWork, uint8_t (*pSource)());	// Initialises the stage with a work area and an input sample source
+void stretch_reset();				// Discards input history and queued output (e.g. after a seek)
+void stretch_setSpeed(uint8_t speed);	// Sets the speed (1/16 x, STRETCH_SPEED_MIN - STRETCH_SPEED_MAX)
+uint8_t stretch_process();			// Produces one hop of output if there is room (true if produced)
+uint8_t stretch_dequeue();			// Reads an output sample (repeats the last sample if none queued)
+
+#ifdef STRETCH_PROFILE
+uint32_t stretch_maxCycles();	// Returns the longest measured time to produce STRETCH_PAGE_SAMPLES of output (CPU cycles)
+#define STRETCH_PAGE_SAMPLES	512	// Output samples per measured page
+#endif
+
+#endif /* STRETCH_H_ */
\ No newline at end of file
@@ -40,6 +40,8 @@ limitations under the License.
 /************************************************************************/
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
  
 #include "lib/fatfs/diskio.h"
  
@@ -48,8 +50,18 @@ limitations under the License.
 /************************************************************************/
 /* GLOBAL VARIABLES                                                     */
 /************************************************************************/
-volatile uint8_t timer_fatfs = TIMER_INTERVAL_FATFS;	// Counter variable for servicing FatFs
-volatile uint16_t timer_led = TIMER_INTERVAL_LED;		// Counter for debug LED flashing
+volatile uint16_t timer_fatfs;		// Counter variable for servicing FatFs
+volatile uint16_t timer_led;		// Counter for debug LED flashing
+
+volatile uint16_t interval_fatfs;	// Timer0 periods per FatFs service interval
+volatile uint16_t interval_led;		// Timer0 periods per debug LED interval
+
+uint16_t rateHz;					// Actual sample rate of the current Timer0 period
+
+// Timer0 CMPA top for each selectable rate
+// Timer0 counts at 2 MHz (/8 prescaler), period = (top + 1) / 2 MHz. The 11.025 and 22.05 kHz
+// rates have no exact period: they run at 11.050 kHz (+0.2 %) and 21.978 kHz (-0.3 %)
+const uint8_t timer_tops[TIMER_RATE_COUNT] PROGMEM = { 249, 180, 127, 90, 63 };
 
 /************************************************************************/
 /* PUBLIC/USER FUNCTIONS                                                */
@@ -62,7 +74,7 @@ volatile uint16_t timer_led = TIMER_INTERVAL_LED;		// Counter for debug LED flas
  * Assumes a 16 MHz system clock. Interrupts at counter top.
  */
 void timer_init() {
-	OCR0A = 128;	// 15.625 kHz (64 us period)
+	timer_setRate(TIMER_RATE_15625, 0);	// 15.625 kHz (64 us period)
 	TCCR0A = 0x02;	// CTC mode
 	TIMSK0 = 0x02;  // Interrupt on CMPA (top)
 	
@@ -71,6 +83,69 @@ void timer_init() {
 	DDRD |= (1<<PIND7);		// Set PORTD7 (LED4) as output
 }
 
+/**
+ * Function: timer_setRate
+ * 
+ * Sets the Timer0 period to one of the selectable sample rates. For
+ * oversampled capture the period is divided by (1 << shift), so the
+ * timer triggers that many conversions per output sample; the ratio 
+ * must divide the period exactly (see timer_divides). The FatFs service 
+ * and LED intervals are rescaled so they keep their period in 
+ * milliseconds. The ADC prescaler must be configured to match the
+ * trigger rate (see adc_setRate).
+ *
+ * Where the rate has no exact period the nearest one is used, and 
+ * timer_getRate returns the rate actually produced (see timer_tops).
+ *
+ * Parameters:
+ *    rate - Selectable sample rate (TIMER_RATE_xxx)
+ *    shift - log2 of oversampling ratio (0 for no oversampling)
+ */
+void timer_setRate(uint8_t rate, uint8_t shift) {
+	if (rate >= TIMER_RATE_COUNT)
+		rate = TIMER_RATE_15625;
+	
+	uint16_t period = pgm_read_byte(&timer_tops[rate]) + 1;
+	
+	rateHz = (F_CPU / 8 + period / 2) / period;	// Rounded to the nearest Hz
+	
+	// The intervals are read by the Timer0 ISR
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		interval_fatfs = ((uint32_t)rateHz << shift) / TIMER_INTERVAL_FATFS_HZ;
+		interval_led = ((uint32_t)rateHz << shift) / TIMER_INTERVAL_LED_HZ;
+		timer_fatfs = interval_fatfs;
+		timer_led = interval_led;
+	}
+	
+	OCR0A = (period >> shift) - 1;
+}
+
+/**
+ * Function: timer_getRate
+ * 
+ * Returns: The actual sample rate (Hz) of the current Timer0 period.
+ */
+uint16_t timer_getRate() {
+	return rateHz;
+}
+
+/**
+ * Function: timer_divides
+ * 
+ * Checks whether the current (not oversampled) Timer0 period splits 
+ * into (1 << shift) equal periods. Where it does not, the oversampled
+ * period would be rounded and the actual output rate would differ from
+ * the nominal rate written into the WAVE header.
+ *
+ * Parameters:
+ *    shift - log2 of oversampling ratio
+ *
+ * Returns: Non-zero if the period divides exactly.
+ */
+uint8_t timer_divides(uint8_t shift) {
+	return !((OCR0A + 1) & ((1 << shift) - 1));
+}
+
 /************************************************************************/
 /* INTERRUPT SERVICE ROUTINES                                           */
 /************************************************************************/
@@ -87,13 +162,13 @@ ISR(TIMER0_COMPA_vect) {
 	
 	// Timer to service FatFs module (~10 ms interval)
 	if (!(--timer_fatfs)) {
-		timer_fatfs = TIMER_INTERVAL_FATFS;
+		timer_fatfs = interval_fatfs;
 		disk_timerproc();
 	}
 	
 	// Timer to flash debug LED (1 Hz, 50% duty cycle flash)
 	if (!(--timer_led)) {
-		timer_led = TIMER_INTERVAL_LED;
+		timer_led = interval_led;
 		//PORTD ^= (1<<PIND7);
 	}
 	
@@ -31,10 +31,23 @@ limitations under the License.
 #ifndef TIMER_H_
 #define TIMER_H_
 
+// Selectable sample rates (Timer0 CMPA period)
+enum {
+	TIMER_RATE_8000,	// 8 kHz
+	TIMER_RATE_11025,	// 11.025 kHz (11.050 kHz actual)
+	TIMER_RATE_15625,	// 15.625 kHz (default)
+	TIMER_RATE_22050,	// 22.05 kHz (21.978 kHz actual)
+	TIMER_RATE_31250,	// 31.25 kHz
+	TIMER_RATE_COUNT
+};
+
 // Defines for timer intervals
-#define TIMER_INTERVAL_FATFS	156		// 10 ms interval
-#define TIMER_INTERVAL_LED		7813	// 500 ms interval
+#define TIMER_INTERVAL_FATFS_HZ	100		// 10 ms interval
+#define TIMER_INTERVAL_LED_HZ	2		// 500 ms interval
 
-void timer_init();	// Initialise and start Timer0
+void timer_init();					// Initialise and start Timer0 at the default sample rate
+void timer_setRate(uint8_t rate, uint8_t shift);	// Sets the Timer0 period to a selectable sample rate (oversampled by 1 << shift)
+uint16_t timer_getRate();			// Returns the actual sample rate (Hz) of the Timer0 period
+uint8_t timer_divides(uint8_t shift);	// Checks the Timer0 period divides exactly into (1 << shift) periods
 
 #endif /* TIMER_H_ */
\ No newline at end of file
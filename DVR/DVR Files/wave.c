@@ -21,8 +21,9 @@ limitations under the License.
  * wave.c - EGB240DVR Library, WAVE file interface
  *
  * Provides an interface to read and write WAVE files to an SD card via
- * the FATFS library. This implementation hardcodes the WAVE filename 
- * to "EGB240.WAV" in the root directory of the SD card.
+ * the FATFS library. Recordings are written to WAVE_FILENAME 
+ * ("EGB240.WAV") in the root directory of the SD card; any WAVE file
+ * may be opened for playback.
  *
  * Requires:
  *   lib/fatfs - FatFs FAT file system library published by ChaN
@@ -49,6 +50,7 @@ limitations under the License.
 /************************************************************************/
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 
 #include <string.h>
 #include <stdio.h>
@@ -57,6 +59,31 @@ limitations under the License.
 #include "lib/fatfs/diskio.h"
 
 #include "wave.h"
+#include "adpcm.h"
+
+// Files are read and written through the file system's sector buffer: the file object holds no
+// sector data (34 bytes rather than 546), which the RAM budget and wave_spareFile rely on
+#if !_FS_TINY
+#error "The WAVE module requires FatFs built with _FS_TINY (lib/fatfs/ffconf.h)"
+#endif
+_Static_assert(sizeof(FIL) < _MIN_SS, "FIL must not hold a sector buffer");
+
+/************************************************************************/
+/* TYPE DEFINITIONS                                                     */
+/************************************************************************/
+
+// A chunk header followed by the start of a "fmt " chunk, as read by read_wave_header
+// (the fmt fields are named as in WAVE_HEADER_FIELDS)
+typedef struct {
+	char		ID[4];			// Chunk ID in ASCII
+	uint32_t	size;			// Size of chunk payload
+	uint16_t	AudioFormat;	// fmt chunk fields, as in the file
+	uint16_t	NumChannels;
+	uint32_t	SampleRate;
+	uint32_t	ByteRate;
+	uint16_t	BlockAlign;
+	uint16_t	BitsPerSample;
+} WAVE_CHUNK;
 
 /************************************************************************/
 /* GLOBAL VARIABLES                                                     */
@@ -64,19 +91,32 @@ limitations under the License.
 FATFS fs;	// File system structure for SD card access
 FIL file;	// File structure for WAVE file access
 
-WAVE_HEADER waveHeader;	// WAVE file header structure for read/write of WAVE file proerties
+uint16_t writeFormat;				// Format tag of the file created with wave_create (used to finalise WAVE header)
+uint16_t writeBlockAlign;			// Block size of the file created with wave_create
+uint8_t writeFmtSize;				// Size of the fmt chunk of the file created with wave_create (over 16: fact chunk follows)
 
-volatile uint32_t sampleCount = 0;	// Sample counter (used to finalise WAVE header)
+volatile uint32_t sampleCount = 0;	// Sample data byte counter (used to finalise WAVE header)
 
 uint8_t finaliseHeader = 0;			// Flag to indicate header must be updated/finalised
+uint8_t fileOpen = 0;				// Flag to indicate file was opened by wave_create/wave_open (must be closed)
+
+DWORD dataSector = 0;				// SD card sector of the first sample in a contiguous reservation (0: none)
+
+DWORD dataOffset = 0;				// File offset of the first sample of the file opened with wave_open
+DWORD dataEnd = 0;					// File offset following the last sample of the file opened with wave_open
+uint16_t dataFrame = 1;				// Bytes per sample frame of the file opened with wave_open (reversal unit)
+uint8_t dataSilence = 0x80;			// Sample byte value of silence in the file opened with wave_open (pads reads past dataEnd)
+DWORD linkMap[WAVE_LINKMAP_SIZE];	// Cluster link map of the file opened with wave_open (fast seek)
+uint8_t writePending = 0;			// Flag to indicate an asynchronous write is in progress
 
 /************************************************************************/
 /* FUNCTION PROTOTYPES                                                  */
 /************************************************************************/
-void write_wave_header();
-uint32_t read_wave_header();
+void write_wave_header(uint32_t samplerate, uint16_t format, uint8_t bps);
+uint8_t read_wave_header(WAVE_INFO* pInfo);
+uint8_t check_wave_format(WAVE_CHUNK* pFmt);
 void finalise_wave_header();
-void initialise_header(uint32_t samplerate, uint8_t bps, uint8_t channels);
+void initialise_header(WAVE_HEADER* pHeader, uint32_t samplerate, uint16_t format, uint8_t bps, uint8_t channels);
 
 /************************************************************************/
 /* PRIVATE/UTILLITY FUNCTIONS                                           */
@@ -87,15 +127,14 @@ void initialise_header(uint32_t samplerate, uint8_t bps, uint8_t channels);
  * 
  * Utility function. Copies first four characters of a null terminated string 
  * into a destination character array. Used to operate on WAVE file headers.
+ * The chunk IDs are kept in program memory (PSTR), not copied into SRAM.
  * 
  * Parameters:
  *   array - Destination array.
- *   string - Source string.
+ *   string - Source string (in program memory).
  */
-void set_char_array(char* array, char* string) {
-	for (int i = 0; i < 4; i++) {
-		array[i] = string[i];
-	}
+void set_char_array(char* array, const char* string) {
+	memcpy_P(array, string, 4);
 }
 
 /**
@@ -106,74 +145,221 @@ void set_char_array(char* array, char* string) {
  * samples are written to the file.
  * 
  * Parameters:
+ *   pHeader - Header to initialise.
  *   samplerate - Sample rate of the WAVE file.
+ *   format - Format tag (WAVE_FORMAT_xxx).
  *   bps - Bits per sample.
  *   channels - Number of audio channels (1 = mono, 2 = stereo, ...).
  */
-void initialise_header(uint32_t samplerate, uint8_t bps, uint8_t channels) {
-	set_char_array(waveHeader.fields.ChunkID, "RIFF");
-	waveHeader.fields.ChunkSize = 0;	// placeholder, update when number of samples is known (36 + dataSize)
-	set_char_array(waveHeader.fields.Format, "WAVE");
-	
-	set_char_array(waveHeader.fields.fmtID, "fmt ");	
-	waveHeader.fields.fmtSize = 16;		// for PCM
-	waveHeader.fields.AudioFormat = 1;	// PCM
-	waveHeader.fields.NumChannels = channels;
-	waveHeader.fields.SampleRate = samplerate;
-	waveHeader.fields.ByteRate = samplerate*channels*(bps>>3);
-	waveHeader.fields.BlockAlign = channels*(bps>>3);
-	waveHeader.fields.BitsPerSample = bps;
-	
-	set_char_array(waveHeader.fields.dataID, "data");
-	waveHeader.fields.dataSize = 0;		// placeholder, update with NumSamples * BlockAlign
+void initialise_header(WAVE_HEADER* pHeader, uint32_t samplerate, uint16_t format, uint8_t bps, uint8_t channels) {
+	set_char_array(pHeader->fields.ChunkID, PSTR("RIFF"));
+	pHeader->fields.ChunkSize = 0;	// placeholder, update when number of samples is known (36 + dataSize)
+	set_char_array(pHeader->fields.Format, PSTR("WAVE"));
+	
+	set_char_array(pHeader->fields.fmtID, PSTR("fmt "));	
+	pHeader->fields.fmtSize = (format == WAVE_FORMAT_PCM) ? 16 : 18;	// 16 for PCM, others add cbSize
+	pHeader->fields.AudioFormat = format;
+	pHeader->fields.NumChannels = channels;
+	pHeader->fields.SampleRate = samplerate;
+	pHeader->fields.ByteRate = samplerate*channels*(bps>>3);
+	pHeader->fields.BlockAlign = channels*(bps>>3);
+	pHeader->fields.BitsPerSample = bps;
+	
+	set_char_array(pHeader->fields.dataID, PSTR("data"));
+	pHeader->fields.dataSize = 0;		// placeholder, update with NumSamples * BlockAlign
+	
+	if (format == WAVE_FORMAT_IMA_ADPCM) {
+		// IMA ADPCM: fmt chunk extended with samples per block, data stored in whole blocks
+		pHeader->fields.fmtSize = 20;
+		pHeader->fields.AudioFormat = WAVE_FORMAT_IMA_ADPCM;
+		pHeader->fields.ByteRate = samplerate*channels*ADPCM_BLOCK_SIZE/ADPCM_BLOCK_SAMPLES;
+		pHeader->fields.BlockAlign = channels*ADPCM_BLOCK_SIZE;
+	}
 }
 
 /**
  * Function: write_wave_header
  * 
  * Writes a WAVE header structure into an open file.
- * Wave configuration is hardcoded to 15625 samples per second, 8 bits per sample, mono.
+ * Wave configuration is hardcoded to mono.
+ * The "fmt " and "data" chunks are separated by a JUNK chunk which pads the header
+ * to WAVE_HEADER_SIZE bytes, so that sample data starts on a sector boundary.
+ * For formats other than PCM the fmt chunk is extended (cbSize, plus samples per
+ * block for IMA ADPCM) and followed by a "fact" chunk holding the sample count
+ * (set on finalisation).
  */
-void write_wave_header() {
+void write_wave_header(uint32_t samplerate, uint16_t format, uint8_t bps) {
 	FRESULT result;
-	uint16_t bw;
+	uint16_t bw, total = 0;
+	WAVE_HEADER header;
+	uint32_t chunk[3];	// fact and JUNK chunk headers (ID, size), and the fact sample count
+	uint16_t n;
+	
+	initialise_header(&header, samplerate, format, bps, 1);	// Create header for mono WAVE file
+	writeFormat = header.fields.AudioFormat;
+	writeBlockAlign = header.fields.BlockAlign;
+	writeFmtSize = (uint8_t)header.fields.fmtSize;
+	
+	result = f_write(&file, &(header.bytes), 36, &bw); // Write RIFF and fmt chunks to file
+	total += bw;
+	
+	if (writeFmtSize > 16) {
+		// fmt extension (cbSize, samples per block) and fact chunk (sample count placeholder)
+		uint16_t extension[2] = { writeFmtSize - 18, ADPCM_BLOCK_SAMPLES };
+		
+		if (!result) result = f_write(&file, extension, writeFmtSize - 16, &bw);
+		total += bw;
+		set_char_array((char*)chunk, PSTR("fact"));
+		chunk[1] = 4;
+		chunk[2] = 0;
+		if (!result) result = f_write(&file, chunk, WAVE_FACT_SIZE, &bw);
+		total += bw;
+	}
 	
-	initialise_header(15625, 8, 1);	// Create header for 15.625 kHz, 8-bit per sample, mono WAVE file
-	result = f_write(&file, &(waveHeader.bytes), 44, &bw); // Write header to file
+	// Write JUNK chunk to pad header, zero filled from the RIFF and fmt chunks (already written)
+	set_char_array((char*)chunk, PSTR("JUNK"));
+	chunk[1] = WAVE_JUNK_SIZE;
+	if (writeFmtSize > 16)
+		chunk[1] -= (writeFmtSize - 16) + WAVE_FACT_SIZE;
+	if (!result) result = f_write(&file, chunk, 8, &bw);
+	total += bw;
+	memset(header.bytes, 0, 36);
+	for (n = chunk[1]; n && !result; n -= bw) {
+		result = f_write(&file, header.bytes, (n < 36) ? n : 36, &bw);
+		total += bw;
+		if (!bw) break;
+	}
+	
+	if (!result) result = f_write(&file, &(header.bytes[36]), 8, &bw); // Write data chunk header
+	total += bw;
 
 	// If error has occurred, write status to console
-	if (result) printf("f_write returned error code: %d\n", result);
-	if (bw != 44) printf("f_write wrote %d of 44 bytes to file.", bw);
+	if (result) printf_P(PSTR("f_write returned error code: %d\n"), result);
+	if (total != WAVE_HEADER_SIZE) printf_P(PSTR("f_write wrote %d of %d bytes to file."), total, WAVE_HEADER_SIZE);
 	
 	// Flag that header requires finalisation
 	finaliseHeader = 1;
 }
 
+/**
+ * Function: check_wave_format
+ * 
+ * Validates the format read from a fmt chunk: a supported format tag,
+ * with bits per sample and block size consistent with it.
+ * 
+ * Parameters:
+ *    pFmt - Chunk holding the start of the fmt chunk.
+ *
+ * Returns: Non-zero if the format can be played
+ */
+uint8_t check_wave_format(WAVE_CHUNK* pFmt) {
+	if (!pFmt->SampleRate || !pFmt->NumChannels || (pFmt->NumChannels > WAVE_CHANNELS_MAX))
+		return 0;
+	
+	switch (pFmt->AudioFormat) {
+		case WAVE_FORMAT_PCM:
+			if ((pFmt->BitsPerSample != 8) && (pFmt->BitsPerSample != 16))
+				return 0;
+			return pFmt->BlockAlign == pFmt->NumChannels * (pFmt->BitsPerSample >> 3);
+		case WAVE_FORMAT_ALAW:
+		case WAVE_FORMAT_MULAW:
+			return (pFmt->BitsPerSample == 8) && (pFmt->BlockAlign == pFmt->NumChannels);
+		case WAVE_FORMAT_IMA_ADPCM:
+			return (pFmt->BitsPerSample == 4) && pFmt->BlockAlign;
+		default:
+			return 0;
+	}
+}
+
 /**
  * Function: read_wave_header
  * 
- * Reads a WAVE header from an open file into a structure.
+ * Walks the RIFF chunks of an open file to locate the "fmt " and "data" 
+ * chunks at any offset, skipping any other chunks (e.g. LIST, fact and 
+ * JUNK). Only chunk headers and the start of the fmt chunk are read (onto
+ * the stack, no header is kept); WAVE_FORMAT_EXTENSIBLE is resolved to the tag of
+ * its sub-format. The walk is bounded by WAVE_CHUNKS_MAX chunks and by the
+ * size of the file, and the data extent is limited to the file (truncated
+ * recordings, or streamed files with an unknown data size).
+ * On success the file pointer is positioned at the first sample.
  * 
- * Returns: The number of samples in the opened wave file (as reported in the header)
+ * Parameters:
+ *    pName - Filename (8.3, root directory of the SD card).
+ *    pInfo - Descriptor filled with the format and data extent of the file.
+ *
+ * Returns: WAVE_OK, or WAVE_ERR_xxx if the file cannot be played
  */
-uint32_t read_wave_header() {
+uint8_t read_wave_header(WAVE_INFO* pInfo) {
 	FRESULT result;
 	uint16_t br;
+	uint8_t chunks;
+	uint8_t found = 0;	// Chunks found (bit 0: "fmt ", bit 1: "data")
+	DWORD pos = 12;		// Offset of the next chunk header
+	DWORD end = f_size(&file);
+	DWORD size;
+	WAVE_CHUNK chunk;
 	
-	// Read header from WAVE file into structure
-	result = f_read(&file, &(waveHeader.bytes), 44, &br);
-
-	// If error has occurred, write status to console
-	if (result) printf("f_read returned error code: %d\n", result);
-	if (br != 44) printf("f_read read %d of 44 bytes from file.", br);
-	
+	// RIFF header (the form type "WAVE" is read into the first fmt field)
+	result = f_read(&file, &chunk, 12, &br);
+	if (result || (br != 12)) 
+		return WAVE_ERR_FILE;
+	if (memcmp_P(chunk.ID, PSTR("RIFF"), 4) || memcmp_P(&chunk.AudioFormat, PSTR("WAVE"), 4))
+		return WAVE_ERR_RIFF;
 	
-	if (result | (br != 44)) {
-		// Return "empty" wave file if read is unsuccessful
-		return 0;
-	} else {
-		return waveHeader.fields.dataSize;
+	for (chunks = WAVE_CHUNKS_MAX; chunks && (found != 3) && (pos + 8 <= end); chunks--) {
+		// Chunk header
+		result = f_lseek(&file, pos);
+		if (!result) result = f_read(&file, &chunk, 8, &br);
+		if (result || (br != 8))
+			return WAVE_ERR_FILE;
+		
+		pos += 8;
+		size = chunk.size;
+		if (size > end - pos)
+			size = end - pos;	// Chunk runs past the end of the file
+		
+		if (!memcmp_P(chunk.ID, PSTR("fmt "), 4)) {
+			if (size < 16)
+				return WAVE_ERR_FORMAT;
+			
+			result = f_read(&file, &chunk.AudioFormat, 16, &br);
+			if (!result && (br == 16) && (chunk.AudioFormat == WAVE_FORMAT_EXTENSIBLE)) {
+				// Sub-format GUID follows cbSize, valid bits and channel mask; its first word is the tag
+				if (size < 26)
+					return WAVE_ERR_FORMAT;
+				result = f_lseek(&file, pos + 24);
+				if (!result) result = f_read(&file, &chunk.AudioFormat, 2, &br);
+				if (br == 2) br = 16;
+			}
+			if (result || (br != 16))
+				return WAVE_ERR_FILE;
+			if (!check_wave_format(&chunk))
+				return WAVE_ERR_FORMAT;
+			
+			pInfo->format = chunk.AudioFormat;
+			pInfo->channels = (uint8_t)chunk.NumChannels;
+			pInfo->bitsPerSample = (uint8_t)chunk.BitsPerSample;
+			pInfo->sampleRate = chunk.SampleRate;
+			pInfo->byteRate = chunk.ByteRate;
+			pInfo->blockAlign = chunk.BlockAlign;
+			found |= 1;
+		} else if (!memcmp_P(chunk.ID, PSTR("data"), 4)) {
+			pInfo->dataOffset = pos;
+			pInfo->dataSize = size;
+			found |= 2;
+		}
+		
+		pos += size + (size & 1);	// Chunks are word aligned
 	}
+	
+	if (!(found & 1))
+		return WAVE_ERR_FORMAT;
+	if (!(found & 2))
+		return WAVE_ERR_DATA;
+	
+	// Position at the first sample
+	result = f_lseek(&file, pInfo->dataOffset);
+	return result ? WAVE_ERR_FILE : WAVE_OK;
 }
 
 /**
@@ -187,21 +373,38 @@ void finalise_wave_header() {
 	
 	// Calculate header fields to update
 	uint32_t dataSize = sampleCount;
-	uint32_t chunkSize = 36 + dataSize;
+	uint32_t chunkSize = (WAVE_HEADER_SIZE - 8) + dataSize;
+	
+	if (writeFmtSize > 16) {
+		uint32_t samples = dataSize / writeBlockAlign;
+		
+		if (writeFormat == WAVE_FORMAT_IMA_ADPCM) {
+			// Sample count of whole blocks, plus any partial block (header sample + 2 per byte)
+			uint16_t partial = dataSize % ADPCM_BLOCK_SIZE;
+			samples = (dataSize / ADPCM_BLOCK_SIZE) * ADPCM_BLOCK_SAMPLES;
+			if (partial >= 4) samples += ((partial - 4) * 2) + 1;
+		}
+		
+		result = f_lseek(&file, 20 + writeFmtSize + 8);	// Seek to fact sample count location
+		if (result) printf_P(PSTR("f_lseek returned error code: %d\n"), result);
+		result = f_write(&file, &samples, 4, &bw);			// Write sample count to file
+		if (result) printf_P(PSTR("f_write returned error code: %d\n"), result);
+		if (bw != 4) printf_P(PSTR("f_write wrote %d of 4 bytes to file."), bw);
+	}
 	
 	// Finalise wave file header
 	// Where errors occur, print to console
 	result = f_lseek(&file, 4);						// Seek to dataSize location
-	if (result) printf("f_lseek returned error code: %d\n", result);
+	if (result) printf_P(PSTR("f_lseek returned error code: %d\n"), result);
 	result = f_write(&file, &chunkSize, 4, &bw);	// Write dataSize field to file
-	if (result) printf("f_write returned error code: %d\n", result);
-	if (bw != 4) printf("f_write wrote %d of 4 bytes to file.", bw);
+	if (result) printf_P(PSTR("f_write returned error code: %d\n"), result);
+	if (bw != 4) printf_P(PSTR("f_write wrote %d of 4 bytes to file."), bw);
 	
-	result = f_lseek(&file, 40);					// Seek to chunkSize location
-	if (result) printf("f_lseek returned error code: %d\n", result);
+	result = f_lseek(&file, WAVE_HEADER_SIZE - 4);	// Seek to chunkSize location
+	if (result) printf_P(PSTR("f_lseek returned error code: %d\n"), result);
 	result = f_write(&file, &dataSize, 4, &bw);		// Write chuckSize field to file
-	if (result) printf("f_write returned error code: %d\n", result);
-	if (bw != 4) printf("f_write wrote %d of 4 bytes to file.", bw);
+	if (result) printf_P(PSTR("f_write returned error code: %d\n"), result);
+	if (bw != 4) printf_P(PSTR("f_write wrote %d of 4 bytes to file."), bw);
 }
 
 /************************************************************************/
@@ -220,87 +423,243 @@ void wave_init() {
 	result = f_mount(&fs, "/", 1);	// force mount SD card root directory
 
 	// If error occurs, write status to console
-	if (result) printf("f_mount returned error code: %d\n", result);
+	if (result) printf_P(PSTR("f_mount returned error code: %d\n"), result);
 }
 
 /**
  * Function: wave_create
  * 
  * Creates a and initialises a WAVE file for read/write access.
- * The WAVE filename is hardcoded to "EGB240.WAV"
+ * The WAVE filename is WAVE_FILENAME ("EGB240.WAV")
  * If a file with the same name exists it is overwritten and cleared.
  * The created WAVE file is initialised with an empty header.
  *
+ * Space for the longest recording is reserved up front as a contiguous
+ * run of clusters, so that f_write follows the existing cluster chain 
+ * rather than allocating clusters (FAT read-modify-write) mid-recording.
+ * The reservation is trimmed to the recorded length by wave_close. If
+ * no contiguous run is free, clusters are allocated as the file grows.
+ * Writes to a reservation are streamed to the SD card in a single open
+ * multi-block write (CMD25), closed by wave_close, and may be made 
+ * asynchronously with wave_writeAsync.
+ *
+ * Parameters:
+ *    samplerate - Sample rate (Hz) to record in the WAVE header.
+ *    format - Format tag (WAVE_FORMAT_xxx).
+ *    bps - Bits per sample (8 for unsigned PCM and G.711, 16 for signed PCM, 4 for IMA ADPCM).
+ *    reserve - Maximum number of sample data bytes to be written (0 for no reservation).
+ *
  * Postcondition:
  *    Creating a wave file resets the sample counter.
  */
-void wave_create() {
+void wave_create(uint32_t samplerate, uint16_t format, uint8_t bps, uint32_t reserve) {
 	FRESULT result;
+	char name[sizeof(WAVE_FILENAME)];
 	
 	// Create new WAVE file with read/write access (force overwrite if file exists)
-	result = f_open(&file, "EGB240.WAV", FA_CREATE_ALWAYS | FA_READ | FA_WRITE);
+	strcpy_P(name, PSTR(WAVE_FILENAME));	// Filename kept in flash
+	result = f_open(&file, name, FA_CREATE_ALWAYS | FA_READ | FA_WRITE);
+	fileOpen = !result;
 
 	// If error occurs, write status to console
-	if (result) printf("f_open returned error code: %d\n", result);
+	if (result) printf_P(PSTR("f_open returned error code: %d\n"), result);
+	
+	// Reserve contiguous clusters for the header and sample data
+	if (!result && reserve) {
+		result = f_expand(&file, WAVE_HEADER_SIZE + reserve);
+		if (result) printf_P(PSTR("f_expand returned error code: %d\n"), result);
+	}
 	
 	// Write WAVE file header to file
-	write_wave_header();
+	write_wave_header(samplerate, format, bps);
+	
+	// Stream sample data into the contiguous reservation through one multi-block write
+	dataSector = 0;
+	if (!result && reserve) {
+		result = f_sync(&file);	// Write header to card before streaming
+		if (result) printf_P(PSTR("f_sync returned error code: %d\n"), result);
+		
+		if (!result) {
+			dataSector = file.dsect + 1;	// Sample data follows header sector
+			if (disk_stream_open(0, dataSector)) printf_P(PSTR("disk_stream_open failed\n"));
+		}
+	}
 	
 	// Reset sample counter
 	sampleCount = 0;
+	writePending = 0;
 }
 
 /**
  * Function: wave_open
  * 
  * Opens an existing WAVE file for read only access.
- * The WAVE filename is hardcoded to "EGB240.WAV"
  *
- * Returns: The number of samples in the opened WAVE file.
+ * Sample data is read ahead: sequential sectors are pulled from one
+ * open multi-block read (CMD18) until wave_close, so reads of several
+ * pages at once (or of consecutive pages) carry no per-sector command
+ * overhead.
+ *
+ * A cluster link map of the file is built once on opening, so that 
+ * wave_seek finds any cluster without following the FAT chain. Files
+ * with more than a few fragments fall back to normal (chain) seeks.
+ *
+ * The "fmt " and "data" chunks are located wherever they are in the 
+ * file (see read_wave_header), so files authored off-device play as
+ * well as recordings.
+ *
+ * Parameters:
+ *    pName - Filename (8.3, root directory of the SD card).
+ *    pInfo - Descriptor filled with the format and data extent of the file.
+ *
+ * Returns: WAVE_OK, or WAVE_ERR_xxx if the file cannot be played (the
+ *          file must still be closed with wave_close, which only closes
+ *          it if it was opened).
  */
-uint32_t wave_open() {
+uint8_t wave_open(const char* pName, WAVE_INFO* pInfo) {
 	FRESULT result;
+	uint8_t status;
 	
 	// Open an existing WAVE file with read only access
-	result = f_open(&file, "EGB240.WAV", FA_READ);
+	result = f_open(&file, pName, FA_READ);
+	fileOpen = !result;
 
 	// If error occurs, write status to console
-	if (result) printf("f_open returned error code: %d\n", result);
+	if (result) printf_P(PSTR("f_open returned error code: %d\n"), result);
+	
+	// Build the cluster link map for fast seek
+	if (!result) {
+		linkMap[0] = WAVE_LINKMAP_SIZE;
+		file.cltbl = linkMap;
+		if (f_lseek(&file, CREATE_LINKMAP))
+			file.cltbl = 0;	// Too fragmented, seek by following the FAT chain
+	}
+	
+	// Read sample data ahead through an open multi-block read
+	if (!result) disk_read_ahead(0, 1);
 	
-	// Read the WAVE file header and return the number of samples reported
-	return read_wave_header();
+	// Locate the format and sample data
+	status = result ? WAVE_ERR_FILE : read_wave_header(pInfo);
+	if (status) {
+		printf_P(PSTR("WAVE file not playable, error code: %d\n"), status);
+		pInfo->dataOffset = 0;
+		pInfo->dataSize = 0;
+	}
+	
+	dataOffset = pInfo->dataOffset;
+	dataEnd = dataOffset + pInfo->dataSize;
+	dataFrame = pInfo->blockAlign ? pInfo->blockAlign : 1;
+	
+	// Silence for reads past the last sample
+	switch (pInfo->format) {
+		case WAVE_FORMAT_MULAW:
+			dataSilence = 0xFF;
+			break;
+		case WAVE_FORMAT_ALAW:
+			dataSilence = 0xD5;
+			break;
+		default:
+			dataSilence = (pInfo->bitsPerSample == 8) ? 0x80 : 0x00;
+			break;
+	}
+	
+	return status;
+}
+
+/**
+ * Function: wave_seek
+ * 
+ * Moves the read position of a WAVE file opened with wave_open to a
+ * byte offset within the sample data. Uses the cluster link map built
+ * by wave_open where available (constant time).
+ *
+ * Parameters:
+ *    offset - Byte offset from the first sample.
+ */
+void wave_seek(uint32_t offset) {
+	FRESULT result;
+	
+	result = f_lseek(&file, dataOffset + offset);
+
+	// If error occurs, write status to console
+	if (result) printf_P(PSTR("f_lseek returned error code: %d\n"), result);
+}
+
+/**
+ * Function: wave_fastSeek
+ * 
+ * Returns: True if the WAVE file opened with wave_open has a cluster link
+ *          map, so that seeks (including backwards) take constant time.
+ */
+uint8_t wave_fastSeek() {
+	return file.cltbl != 0;
+}
+
+/**
+ * Function: wave_spareFile
+ * 
+ * Lends the file object of the WAVE module, so that another file (the
+ * playlist) can be read between WAVE files without a file object on 
+ * the stack. It may only be used while no WAVE file is open, and must 
+ * be closed before wave_create or wave_open is next called.
+ *
+ * Returns: Pointer to the spare file object.
+ */
+FIL* wave_spareFile() {
+	return &file;
 }
 
 /**
  * Function: wave_close
  * 
- * Closes an open WAVE file. If required, the WAVE file header is finalised prior to closing.
+ * Closes an open WAVE file. If required, the WAVE file header is finalised prior to closing
+ * and any space reserved beyond the last sample is released. Does nothing if the file
+ * could not be opened, or is already closed.
  */
 void wave_close() {
 	FRESULT result;
 	
+	if (!fileOpen) {
+		finaliseHeader = 0;	// File could not be created, no header to finalise
+		return;
+	}
+	fileOpen = 0;
+	
 	if (finaliseHeader) {
 		// Only finalise header where WAVE file is newly created 
 		finaliseHeader = 0;
+		
+		// Complete any asynchronous write and end multi-block write of sample data (if streaming)
+		while (wave_poll());
+		if (disk_stream_close(0)) printf_P(PSTR("disk_stream_close failed\n"));
+		
+		// Truncate reservation to the samples written
+		result = f_lseek(&file, WAVE_HEADER_SIZE + sampleCount);
+		if (!result) result = f_truncate(&file);
+		if (result) printf_P(PSTR("f_truncate returned error code: %d\n"), result);
+		
 		finalise_wave_header();
 	}
 	
+	// End multi-block read of sample data (if reading)
+	disk_read_ahead(0, 0);
+	
 	// Close WAVE file
 	result = f_close(&file);
 
 	// If error occurs, write status to console
-	if (result) printf("f_close returned error code: %d\n", result);
+	if (result) printf_P(PSTR("f_close returned error code: %d\n"), result);
 }
 
 /**
  * Function: wave_write
  * 
  * Writes a number of audio samples into a open WAVE file.
- * This function expects 8-bit audio samples.
+ * Samples must be in the format given to wave_create.
  *
  * Parameters:
- *    pSamples - Pointer to array of 8-bit audio samples to write to WAVE file.
- *    count - Number of samples to write from array into WAVE file.
+ *    pSamples - Pointer to array of audio samples to write to WAVE file.
+ *    count - Number of bytes to write from array into WAVE file.
  */
 void wave_write(uint8_t* pSamples, uint16_t count) {
 	FRESULT result;
@@ -309,30 +668,169 @@ void wave_write(uint8_t* pSamples, uint16_t count) {
 	result = f_write(&file, pSamples, count, &bw); // Write samples to file
 
 	// If error occurs, write status to console
-	if (result) printf("f_write returned error code: %d\n", result);
-	if (bw != count) printf("f_write wrote %d of %d bytes to file.", bw, count);
+	if (result) printf_P(PSTR("f_write returned error code: %d\n"), result);
+	if (bw != count) printf_P(PSTR("f_write wrote %d of %d bytes to file."), bw, count);
 
 	// Increment sample count by number of samples written to file
 	sampleCount += bw;
 }
 
+/**
+ * Function: wave_writeAsync
+ * 
+ * Starts writing a sector (WAVE_SECTOR_SIZE bytes) of audio samples
+ * into an open WAVE file, and returns without waiting for the SD card.
+ * The transfer is advanced by wave_poll; the samples must remain 
+ * valid until wave_poll returns false. Must only be called when no
+ * write is in progress, and must not be mixed with wave_write.
+ *
+ * Writes go directly to the contiguous reservation made by wave_create
+ * (bypassing the file system). If there is no reservation, the samples 
+ * are written synchronously with wave_write.
+ *
+ * Parameters:
+ *    pSamples - Pointer to a sector of audio samples to write to WAVE file.
+ */
+void wave_writeAsync(uint8_t* pSamples) {
+	DRESULT result;
+	
+	if (!dataSector) {
+		wave_write(pSamples, WAVE_SECTOR_SIZE);
+		return;
+	}
+	
+	result = disk_write_async(0, pSamples, dataSector + (sampleCount / WAVE_SECTOR_SIZE));
+	
+	// If error occurs, write status to console
+	if (result) printf_P(PSTR("disk_write_async returned error code: %d\n"), result);
+	else writePending = 1;
+}
+
+/**
+ * Function: wave_poll
+ * 
+ * Advances an asynchronous write started with wave_writeAsync. Each 
+ * call transfers part of the sector or checks whether the SD card has 
+ * finished programming it, so the caller is never held up for long.
+ *
+ * Returns: True while the write is in progress, false once complete (or if none).
+ */
+uint8_t wave_poll() {
+	DRESULT result;
+	
+	if (!writePending)
+		return 0;
+	
+	result = disk_poll(0);
+	if (result == RES_NOTRDY)
+		return 1;
+	
+	writePending = 0;
+	
+	// If error occurs, write status to console
+	if (result) printf_P(PSTR("disk_poll returned error code: %d\n"), result);
+	else sampleCount += WAVE_SECTOR_SIZE;	// Sector written
+	
+	return 0;
+}
+
 /**
  * Function: wave_read
  * 
  * Reads a number of audio samples from an open WAVE file.
- * This function expects 8-bit audio samples.
+ * Samples are in the format described by the WAVE_INFO descriptor 
+ * filled by wave_open. Reads stop at the end of the sample data (any 
+ * chunks that follow it are not read), and the rest of the array is 
+ * filled with silence.
  *
  * Parameters:
- *    pSamples - Pointer to array of 8-bit audio samples into which samples will be read.
- *    count - Number of samples to read into array from WAVE file.
+ *    pSamples - Pointer to array of audio samples into which samples will be read.
+ *    count - Number of bytes to read into array from WAVE file.
  */
 void wave_read(uint8_t* pSamples, uint16_t count) {
 	FRESULT result;
 	uint16_t br;
+	DWORD left = wave_remaining();
+	
+	if (count > left) {
+		memset(pSamples + left, dataSilence, count - left);
+		count = left;
+		if (!count)
+			return;	// All silence (the file may not be open)
+	}
 	
 	result = f_read(&file, pSamples, count, &br); // Read samples from file
 
 	// If error occurs, write status to console
-	if (result) printf("f_write returned error code: %d\n", result);
-	if (br != count) printf("f_write wrote %d of %d bytes to file.", br, count);
+	if (result) printf_P(PSTR("f_write returned error code: %d\n"), result);
+	if (br != count) printf_P(PSTR("f_write wrote %d of %d bytes to file."), br, count);
+}
+
+/**
+ * Function: wave_readBack
+ * 
+ * Reads the samples preceding the read position of a WAVE file opened
+ * with wave_open, reversed, and moves the read position back to the 
+ * first of them, so that consecutive calls stream the file backwards.
+ * The block is read forwards (sequential sectors are read ahead) and 
+ * reversed in place a sample frame at a time. Samples before the first
+ * sample of the file are silence (at the end of the reversed block).
+ * Seeks backwards use the cluster link map where available.
+ *
+ * Parameters:
+ *    pSamples - Pointer to array of audio samples into which samples will be read.
+ *    count - Number of bytes to read (whole frames).
+ */
+void wave_readBack(uint8_t* pSamples, uint16_t count) {
+	FRESULT result;
+	DWORD end = f_tell(&file);
+	uint16_t n = count;
+	uint8_t* pHead;
+	uint8_t* pTail;
+	uint16_t i;
+	uint8_t t;
+	
+	if (end < dataOffset + count)
+		n = (end > dataOffset) ? end - dataOffset : 0;
+	
+	// Read the block forwards behind any silence
+	memset(pSamples, dataSilence, count - n);
+	result = f_lseek(&file, end - n);
+	if (!result) wave_read(pSamples + (count - n), n);
+	
+	// Reverse the order of the frames
+	pHead = pSamples;
+	pTail = pSamples + count - dataFrame;
+	if (dataFrame == 1) {
+		for (; pHead < pTail; pHead++, pTail--) {
+			t = *pHead;
+			*pHead = *pTail;
+			*pTail = t;
+		}
+	} else {
+		for (; pHead < pTail; pTail -= 2 * dataFrame) {
+			for (i = 0; i < dataFrame; i++, pHead++, pTail++) {
+				t = *pHead;
+				*pHead = *pTail;
+				*pTail = t;
+			}
+		}
+	}
+	
+	// Next block ends where this one starts
+	if (!result) result = f_lseek(&file, end - n);
+	
+	// If error occurs, write status to console
+	if (result) printf_P(PSTR("f_lseek returned error code: %d\n"), result);
+}
+
+/**
+ * Function: wave_remaining
+ * 
+ * Returns: The number of bytes of sample data following the read position
+ *          of the WAVE file opened with wave_open (0 at the end of the data,
+ *          or if the file could not be opened).
+ */
+uint32_t wave_remaining() {
+	return (f_tell(&file) < dataEnd) ? dataEnd - f_tell(&file) : 0;
 }
\ No newline at end of file
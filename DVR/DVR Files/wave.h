@@ -20,8 +20,9 @@ limitations under the License.
  * wave.h - EGB240DVR Library, WAVE file interface header
  *
  * Provides an interface to read and write WAVE files to an SD card via
- * the FATFS library. This implementation hardcodes the WAVE filename 
- * to "EGB240.WAV" in the root directory of the SD card.
+ * the FATFS library. Recordings are written to WAVE_FILENAME 
+ * ("EGB240.WAV") in the root directory of the SD card; any WAVE file
+ * may be opened for playback.
  *
  * Version: v1.0
   *    Date: 05/29/2017
@@ -32,6 +33,42 @@ limitations under the License.
 #ifndef WAVE_H_
 #define WAVE_H_
 
+#include "lib/fatfs/ff.h"
+
+// The WAVE header is padded to a full SD card sector with a JUNK chunk
+// (placed between the "fmt " and "data" chunks) so that sample data
+// starts on a sector boundary. Whole pages of samples are then written
+// and read by FatFs directly between the buffer and the SD card.
+#define WAVE_FILENAME		"EGB240.WAV"	// File recorded by wave_create (and played when there is no playlist)
+
+#define WAVE_SECTOR_SIZE	512
+#define WAVE_HEADER_SIZE	WAVE_SECTOR_SIZE						// Size of header, offset of first sample
+#define WAVE_JUNK_SIZE		(WAVE_HEADER_SIZE - 44 - 8)				// Size of JUNK chunk payload
+
+#define WAVE_FACT_SIZE		12										// Size of fact chunk (non-PCM formats), taken from the JUNK chunk
+
+// Cluster link map for fast seek: 2 entries per fragment plus 2
+// (recorded files are contiguous, a single fragment)
+#define WAVE_LINKMAP_SIZE	6										// Size of link map (DWORDs), up to 2 fragments
+
+// WAVE format tags
+#define WAVE_FORMAT_PCM			0x01	// Linear PCM
+#define WAVE_FORMAT_ALAW		0x06	// G.711 A-law
+#define WAVE_FORMAT_MULAW		0x07	// G.711 mu-law
+#define WAVE_FORMAT_IMA_ADPCM	0x11	// IMA ADPCM
+#define WAVE_FORMAT_EXTENSIBLE	0xFFFE	// Extensible, format tag taken from the sub-format GUID
+
+// Chunk walk limits for files opened with wave_open (files authored off-device)
+#define WAVE_CHUNKS_MAX		16		// Maximum number of chunks examined for "fmt " and "data"
+#define WAVE_CHANNELS_MAX	2		// Maximum number of channels accepted
+
+// wave_open results
+#define WAVE_OK				0		// File opened, descriptor valid
+#define WAVE_ERR_FILE		1		// File could not be opened or read
+#define WAVE_ERR_RIFF		2		// Not a RIFF WAVE file
+#define WAVE_ERR_FORMAT		3		// Missing or unsupported "fmt " chunk
+#define WAVE_ERR_DATA		4		// Missing "data" chunk
+
 // WAVE file header structure
 typedef struct {
 	char		ChunkID[4];	// Contains "RIFF" in ASCII
@@ -58,11 +95,30 @@ typedef union {
 	uint8_t bytes[44];
 } WAVE_HEADER;
 
+// Descriptor of a WAVE file opened for playback, as located by the chunk walker
+typedef struct {
+	uint16_t	format;			// Format tag (WAVE_FORMAT_xxx, sub-format of WAVE_FORMAT_EXTENSIBLE)
+	uint8_t		channels;		// Number of channels
+	uint8_t		bitsPerSample;	// Bits per sample (per channel)
+	uint32_t	sampleRate;		// Sample rate (Hz)
+	uint32_t	byteRate;		// Average bytes per second
+	uint16_t	blockAlign;		// Bytes per sample frame (ADPCM: per block)
+	uint32_t	dataOffset;		// File offset of the first sample
+	uint32_t	dataSize;		// Bytes of sample data (limited to the end of the file)
+} WAVE_INFO;
+
 void wave_init();		// Initialise WAVE file interface
-void wave_create();		// Create and open new WAVE file (read/write)
-uint32_t wave_open();	// Open existing wave file (read only)
+void wave_create(uint32_t samplerate, uint16_t format, uint8_t bps, uint32_t reserve);	// Create and open new WAVE file (read/write), reserving space for samples
+uint8_t wave_open(const char* pName, WAVE_INFO* pInfo);	// Open existing wave file (read only), locating its format and sample data
+void wave_seek(uint32_t offset);	// Move the read position to a byte offset within the sample data
+uint8_t wave_fastSeek();	// True if the open WAVE file seeks through a cluster link map (constant time)
+FIL* wave_spareFile();	// File object of the WAVE module, free to read another file while no WAVE file is open
 void wave_write(uint8_t* pSamples, uint16_t count);	// Write samples to a WAVE file
-void wave_read(uint8_t* pSamples, uint16_t count);	// Read samples from WAVE file
+void wave_writeAsync(uint8_t* pSamples);	// Start writing a sector of samples to a WAVE file
+uint8_t wave_poll();	// Advance an asynchronous write, returns true while in progress
+void wave_read(uint8_t* pSamples, uint16_t count);	// Read samples from WAVE file (sequential sectors are read ahead, silence past the data)
+void wave_readBack(uint8_t* pSamples, uint16_t count);	// Read the samples preceding the read position, reversed, and move back over them
+uint32_t wave_remaining();	// Bytes of sample data following the read position
 void wave_close();		// Close wave file opened with wave_create or wave_open
 
 #endif /* WAVE_H_ */
\ No newline at end of file